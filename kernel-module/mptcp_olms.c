@@ -13,6 +13,13 @@
 #include <linux/fs.h> // register_chrdev and unregister_chrdev
 #include <linux/kernel.h> // printk
 #include <linux/cdev.h> // character device stuff
+#include <linux/mm.h> // vm_insert_page
+#include <linux/gfp.h> // get_zeroed_page
+#include <linux/poll.h> // poll_wait
+#include <linux/rcupdate.h> // rcu_assign_pointer, kfree_rcu
+#include <linux/slab.h> // kmalloc
+#include "olms-shm.h"
+#include "olms-sched.h"
 
 #define MODULE_NAME "olms"
 
@@ -41,10 +48,33 @@ static unsigned long path_status_bits;
 static u32 last_srtt = 0xffffffff;
 static bool olms_enabled = false;
 
-static u32 pref[2];
-static unsigned long pref_index_bits = 0;
+/* serializes the writers of olms_pref */
 static spinlock_t pref_lock;
 
+/* measurements of the target connection, mapped by userspace */
+static struct olms_shm_page *shm_page;
+/* woken on every publication of the page */
+static DECLARE_WAIT_QUEUE_HEAD(olms_wait);
+
+/*
+ * The preferred subflows set by userspace, see olms-sched.h. A new
+ * preference replaces the whole struct, so the scheduler reads it under
+ * rcu_read_lock() only.
+ */
+struct olms_pref {
+	struct rcu_head rcu;
+	/* the page generation when the preference was set */
+	u32 generation;
+	u32 count;
+	u64 masks[OLMS_EXCHANGE_MAX_BATCH];
+	/* split by deficit round robin if any weight is set */
+	bool weighted;
+	u32 weights[OLMS_SHM_MAX_SUBFLOWS];
+};
+static struct olms_pref __rcu *olms_pref;
+/* deficits of the target connection, under the meta socket lock */
+static struct olms_drr olms_drr;
+
 struct olmssched_priv {
 	u32	last_rbuf_opti;
 };
@@ -129,12 +159,33 @@ static bool mptcp_olms_is_temp_unavailable(struct sock *sk,
 	return false;
 }
 
+static void olms_wake_pollers(void)
+{
+	if (wq_has_sleeper(&olms_wait))
+		wake_up_interruptible_poll(&olms_wait, EPOLLIN | EPOLLRDNORM);
+}
+
+/*
+ * Forget the deficits and the subflows of the last target. The empty
+ * publication, with no established subflow, tells userspace that its
+ * connection ended.
+ */
+static void olms_reset_target(void)
+{
+	memset(&olms_drr, 0, sizeof(olms_drr));
+	if (!shm_page)
+		return;
+	olms_shm_write_begin(shm_page);
+	olms_shm_write_end(shm_page, 0, 0);
+	olms_wake_pollers();
+}
+
 static void check_olms_target(struct sock *meta_sk)
 {
 	struct inet_sock *inet;
 	struct mptcp_tcp_sock *mptcp;
 
-	if (unlikely(target_mpcb))
+	if (unlikely(READ_ONCE(target_mpcb)))
 		return;
 
 	inet = inet_sk(meta_sk);
@@ -142,7 +193,13 @@ static void check_olms_target(struct sock *meta_sk)
 	if (likely(ntohs(inet->inet_dport) != 8999))
 		return;
 
-	target_mpcb = tcp_sk(meta_sk)->mpcb;
+	/*
+	 * Connections to the port run under their own meta locks: only the
+	 * one that claims the target writes the page, until it releases it.
+	 */
+	if (cmpxchg(&target_mpcb, NULL, tcp_sk(meta_sk)->mpcb))
+		return;
+	olms_reset_target();
 	/* FIXME */
 	mptcp_for_each_sub(target_mpcb, mptcp)
 	{
@@ -158,20 +215,102 @@ static void check_olms_target(struct sock *meta_sk)
 		ntohs(inet->inet_dport));
 }
 
+/* Delivery rate of the last sample in bytes per second, as in tcp_get_info() */
+static u32 olms_delivery_rate(const struct tcp_sock *tp)
+{
+	u64 rate;
+
+	if (!tp->rate_interval_us)
+		return 0;
+	rate = (u64)tp->rate_delivered * tp->mss_cache * USEC_PER_SEC;
+	do_div(rate, tp->rate_interval_us);
+	return min_t(u64, rate, U32_MAX);
+}
+
+/*
+ * Publish the measurements of the target connection to the shared page
+ * when a subflow has a new sample, i.e. its srtt or delivered count moved
+ * on an ACK, or when the established subflows changed, and wake the
+ * pollers. The subflow gone, if any, is being released: it is left out.
+ * The scheduler and the release run under the meta socket lock, so there
+ * is a single writer.
+ */
+static void olms_publish_measurements(struct mptcp_cb *mpcb,
+				      const struct sock *gone)
+{
+	struct mptcp_tcp_sock *mptcp;
+	u32 num_subflows = 0, num_established = 0;
+	bool changed = gone != NULL;
+
+	if (!shm_page || mpcb != target_mpcb)
+		return;
+
+	mptcp_for_each_sub(mpcb, mptcp) {
+		struct tcp_sock *tp = mptcp->tp;
+
+		if (mptcp_to_sock(mptcp) == gone)
+			continue;
+		if (mptcp->fully_established)
+			num_established++;
+		if (olms_shm_subflow_changed(shm_page, tp->mptcp->path_index,
+					     tp->srtt_us >> 3, tp->delivered))
+			changed = true;
+	}
+	if (!changed && num_established == shm_page->num_established)
+		return;
+
+	olms_shm_write_begin(shm_page);
+	mptcp_for_each_sub(mpcb, mptcp) {
+		struct tcp_sock *tp = mptcp->tp;
+		int pi = tp->mptcp->path_index;
+
+		if (mptcp_to_sock(mptcp) == gone)
+			continue;
+		olms_shm_set_subflow(shm_page, pi, tp->srtt_us >> 3,
+				     olms_delivery_rate(tp), tp->lost,
+				     tp->delivered);
+		if (pi > num_subflows)
+			num_subflows = pi;
+	}
+	olms_shm_write_end(shm_page, num_subflows, num_established);
+	olms_wake_pollers();
+}
+
+/*
+ * Start a choice under the preference of the current publication, none
+ * for other connections. The caller holds rcu_read_lock() until the
+ * choice is charged, as the choice points to the weights.
+ */
+static void olms_choice_start(struct mptcp_cb *mpcb, struct olms_choice *c)
+{
+	const struct olms_pref *p;
+
+	olms_choice_init(c, 0, NULL, NULL);
+	if (!shm_page || mpcb != target_mpcb)
+		return;
+
+	p = rcu_dereference(olms_pref);
+	if (p)
+		olms_choice_init(c, olms_pref_mask(p->masks, p->count,
+						   shm_page->generation - p->generation),
+				 p->weighted ? p->weights : NULL, &olms_drr);
+}
+
 /* Generic function to iterate over used and unused subflows and to select the
- * best one
+ * best one, by the weights or among the preferred ones of the choice
  */
 static struct sock
 *olms_get_subflow_from_selectors(struct mptcp_cb *mpcb, struct sk_buff *skb,
 				bool (*selector)(const struct tcp_sock *),
-				bool zero_wnd_test, bool *force)
+				bool zero_wnd_test, struct olms_choice *choice,
+				bool *force)
 {
 	struct sock *bestsk = NULL;
-	u32 min_srtt = 0xffffffff;
 	bool found_unused = false;
 	bool found_unused_una = false;
 	struct mptcp_tcp_sock *mptcp;
 
+	olms_choice_reset(choice);
 	mptcp_for_each_sub(mpcb, mptcp) {
 		struct sock *sk = mptcp_to_sock(mptcp);
 		struct tcp_sock *tp = tcp_sk(sk);
@@ -204,8 +343,7 @@ static struct sock
 				 * sk - thus we reset the bestsk (which might
 				 * have been set to a used sk).
 				 */
-				min_srtt = 0xffffffff;
-				bestsk = NULL;
+				olms_choice_reset(choice);
 			}
 			found_unused = true;
 		}
@@ -237,12 +375,11 @@ static struct sock
 		//%li, Queue Size: %u, Service Time: %u", tp->mptcp->path_index,
 		//tp->srtt_us, wait_time, wait_time/10000000, qSize, curr_service);
 
-		if (tp->srtt_us < min_srtt) {
-			min_srtt = tp->srtt_us;
-			bestsk = sk;
-		}
+		olms_choice_consider(choice, sk, tp->mptcp->path_index,
+				     tp->srtt_us);
 	}
 
+	bestsk = olms_choice_result(choice);
 	if (bestsk) {
 		/* The force variable is used to mark the returned sk as
 		 * previously used or not-used.
@@ -262,7 +399,7 @@ static struct sock
 	}
 
 	if (last_srtt == 0 || last_srtt == 0xffffffff) {
-		last_srtt = min_srtt;
+		last_srtt = choice->best_srtt;
 	}
 
 	return bestsk;
@@ -270,19 +407,24 @@ static struct sock
 
 /* This is the scheduler. This function decides on which flow to send
  * a given MSS. If all subflows are found to be busy, NULL is returned
- * The flow is selected based on the shortest RTT.
+ * The flow is selected by the weights or the preferred subflows of
+ * userspace, see olms-sched.h, and otherwise based on the shortest RTT.
  * If all paths have full cong windows, we simply return NULL.
  *
  * Additionally, this function is aware of the backup-subflows.
  */
-struct sock *olms_get_available_subflow(struct sock *meta_sk, struct sk_buff *skb,
-					bool zero_wnd_test)
+static struct sock *__olms_get_available_subflow(struct sock *meta_sk,
+						 struct sk_buff *skb,
+						 bool zero_wnd_test,
+						 struct olms_choice *choice)
 {
 	struct mptcp_cb *mpcb = tcp_sk(meta_sk)->mpcb;
 	struct sock *sk;
 	bool looping = false, force;
 
 	check_olms_target(meta_sk);
+	olms_publish_measurements(mpcb, NULL);
+	olms_choice_start(mpcb, choice);
 
 	/* Answer data_fin on same subflow!!! */
 	if (meta_sk->sk_shutdown & RCV_SHUTDOWN &&
@@ -301,7 +443,7 @@ struct sock *olms_get_available_subflow(struct sock *meta_sk, struct sk_buff *sk
 	/* Find the best subflow */
 restart:
 	sk = olms_get_subflow_from_selectors(mpcb, skb, &subflow_is_active,
-					zero_wnd_test, &force);
+					zero_wnd_test, choice, &force);
 	if (force)
 		/* one unused active sk or one NULL sk when there is at least
 		 * one temporally unavailable unused active sk
@@ -309,7 +451,7 @@ restart:
 		return sk;
 
 	sk = olms_get_subflow_from_selectors(mpcb, skb, &subflow_is_backup,
-					zero_wnd_test, &force);
+					zero_wnd_test, choice, &force);
 	if (!force && skb) {
 		/* one used backup sk or one NULL sk where there is no one
 		 * temporally unavailable unused backup sk
@@ -327,6 +469,19 @@ restart:
 	return sk;
 }
 
+struct sock *olms_get_available_subflow(struct sock *meta_sk, struct sk_buff *skb,
+					bool zero_wnd_test)
+{
+	struct olms_choice choice;
+	struct sock *sk;
+
+	rcu_read_lock();
+	sk = __olms_get_available_subflow(meta_sk, skb, zero_wnd_test, &choice);
+	rcu_read_unlock();
+
+	return sk;
+}
+
 static struct sk_buff *mptcp_olms_rcv_buf_optimization(struct sock *sk, int penal)
 {
 	struct sock *meta_sk;
@@ -453,6 +608,7 @@ static struct sk_buff *mptcp_olms_next_segment(struct sock *meta_sk,
 					unsigned int *limit)
 {
 	struct sk_buff *skb = __mptcp_olms_next_segment(meta_sk, reinject);
+	struct olms_choice choice;
 	unsigned int mss_now;
 	struct tcp_sock *subtp;
 	u16 gso_max_segs;
@@ -464,9 +620,12 @@ static struct sk_buff *mptcp_olms_next_segment(struct sock *meta_sk,
 	if (!skb)
 		return NULL;
 
-	*subsk = olms_get_available_subflow(meta_sk, skb, false);
-	if (!*subsk)
-		return NULL;
+	rcu_read_lock();
+	*subsk = __olms_get_available_subflow(meta_sk, skb, false, &choice);
+	if (!*subsk) {
+		skb = NULL;
+		goto out;
+	}
 
 	subtp = tcp_sk(*subsk);
 	mss_now = tcp_current_mss(*subsk);
@@ -476,12 +635,12 @@ static struct sk_buff *mptcp_olms_next_segment(struct sock *meta_sk,
 		if (skb)
 			*reinject = -1;
 		else
-			return NULL;
+			goto out;
 	}
 
 	/* No splitting required, as we will only send one single segment */
 	if (skb->len <= mss_now)
-		return skb;
+		goto charge;
 
 	/* The following is similar to tcp_mss_split_point, but
 	 * we do not care about nagle, because we will anyways
@@ -495,8 +654,10 @@ static struct sk_buff *mptcp_olms_next_segment(struct sock *meta_sk,
 	if (!gso_max_segs) /* No gso supported on the subflow's NIC */
 		gso_max_segs = 1;
 	max_segs = min_t(unsigned int, tcp_cwnd_test(subtp, skb), gso_max_segs);
-	if (!max_segs)
-		return NULL;
+	if (!max_segs) {
+		skb = NULL;
+		goto out;
+	}
 
 	max_len = mss_now * max_segs;
 	window = tcp_wnd_end(subtp) - subtp->write_seq;
@@ -509,6 +670,11 @@ static struct sk_buff *mptcp_olms_next_segment(struct sock *meta_sk,
 		/* Or, take the window */
 		*limit = needed;
 
+charge:
+	/* the weights count the bytes this segment sends */
+	olms_choice_charge(&choice, *limit ? *limit : skb->len);
+out:
+	rcu_read_unlock();
 	return skb;
 }
 
@@ -668,17 +834,106 @@ static void olmssched_init(struct sock *sk)
 	def_p->last_rbuf_opti = tcp_jiffies32;
 }
 
-static void olms_update_preference(u32 *paths, int n)
+/*
+ * A subflow is released, still linked to its connection. The target is
+ * published without it; with the last one, the target ends, so that
+ * userspace sees no established subflow and the next connection to the
+ * port becomes the target.
+ */
+static void olmssched_release(struct sock *sk)
 {
+	struct mptcp_cb *mpcb = tcp_sk(sk)->mpcb;
+	struct mptcp_tcp_sock *mptcp;
+	int pi = tcp_sk(sk)->mptcp->path_index;
+
+	if (mpcb != target_mpcb)
+		return;
+
+	/* a later subflow on the path index starts without a deficit */
+	if (pi >= 1 && pi <= OLMS_SHM_MAX_SUBFLOWS)
+		olms_drr.deficit[pi - 1] = 0;
+	mptcp_for_each_sub(mpcb, mptcp) {
+		if (mptcp_to_sock(mptcp) != sk) {
+			olms_publish_measurements(mpcb, sk);
+			return;
+		}
+	}
+	target_num_subflows = 0;
+	path_status_bits = 0;
+	olms_reset_target();
+	/* the next target writes the page after the reset */
+	smp_store_release(&target_mpcb, NULL);
+}
+
+/*
+ * Publish a preference filled in by the caller; the scheduler sees either
+ * the old or the new one. The old one is freed after its readers left it.
+ * Returns the generation of the page the preference applies from.
+ */
+static u32 olms_set_preference(struct olms_pref *p)
+{
+	struct olms_pref *old;
+	u32 generation;
 	int i;
 
+	p->weighted = false;
+	for (i = 0; i < OLMS_SHM_MAX_SUBFLOWS; i++)
+		p->weighted |= p->weights[i] != 0;
+	generation = READ_ONCE(shm_page->generation);
+	p->generation = generation;
+
 	spin_lock(&pref_lock);
-	pref_index_bits = 0;
-	for (i = 0; i < n; i++) {
-		set_bit(paths[i] + 1, &pref_index_bits);
-		pref[i] = paths[i] + 1;
-	}
+	old = rcu_dereference_protected(olms_pref, lockdep_is_held(&pref_lock));
+	rcu_assign_pointer(olms_pref, p);
 	spin_unlock(&pref_lock);
+
+	if (old)
+		kfree_rcu(old, rcu);
+	return generation;
+}
+
+/* the generation of the page that an open file has seen */
+static u32 olms_seen(const struct file *filp)
+{
+	return (u32)(unsigned long)filp->private_data;
+}
+
+static void olms_set_seen(struct file *filp, u32 generation)
+{
+	filp->private_data = (void *)(unsigned long)generation;
+}
+
+/*
+ * OLMS_IOC_EXCHANGE: set the preferred subflows, or a batch of them, and
+ * the weights in place of the older ones, in one crossing. Userspace
+ * reads the measurements through the mapping; it gets the generation the
+ * preference applies from, to wait for a sample taken under it.
+ */
+static long olms_exchange(struct file *filp, struct olms_exchange __user *uex)
+{
+	struct olms_pref *p;
+	u32 version, count, generation;
+
+	if (get_user(version, &uex->version) || get_user(count, &uex->count))
+		return -EFAULT;
+	if (version != OLMS_EXCHANGE_VERSION)
+		return -EINVAL;
+	if (count < 1 || count > OLMS_EXCHANGE_MAX_BATCH)
+		return -EINVAL;
+
+	p = kmalloc(sizeof(*p), GFP_KERNEL);
+	if (!p)
+		return -ENOMEM;
+	if (copy_from_user(p->masks, uex->prefer_bits, count * sizeof(u64)) ||
+	    copy_from_user(p->weights, uex->weights, sizeof(p->weights))) {
+		kfree(p);
+		return -EFAULT;
+	}
+	p->count = count;
+	generation = olms_set_preference(p);
+	olms_set_seen(filp, generation);
+
+	return put_user(generation, &uex->generation) ? -EFAULT : 0;
 }
 
 /* Get path one-to-one correspondence between kernel space and user space. */
@@ -733,15 +988,29 @@ static int olms_num_paths(void *data)
 	return 0;
 }
 
+/* args->start holds args->len path ids, path id i is path index i + 1 */
 static int olms_set_preferred_paths(void *data)
 {
 	struct olms_cmd_args *args = data;
-	int err;
+	u32 paths[OLMS_SHM_MAX_SUBFLOWS];
+	struct olms_pref *p;
+	int i;
 
-	err = !access_ok(VERIFY_READ, args->start, args->len * sizeof(u32));
-	return err;
+	if (args->len > OLMS_SHM_MAX_SUBFLOWS)
+		return -EINVAL;
+	if (copy_from_user(paths, (const u32 __user *)args->start,
+			   args->len * sizeof(u32)))
+		return -EFAULT;
 
-	olms_update_preference((u32 *)args->start, args->len);
+	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	if (!p)
+		return -ENOMEM;
+	for (i = 0; i < args->len; i++) {
+		if (paths[i] < OLMS_SHM_MAX_SUBFLOWS)
+			p->masks[0] |= 1ULL << paths[i];
+	}
+	p->count = 1;
+	olms_set_preference(p);
 
 	return 0;
 }
@@ -789,6 +1058,12 @@ static long olms_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		return -EFAULT;
 	}
 
+	/* does not fit struct olms_cmd_args */
+	if (cmd == OLMS_IOC_EXCHANGE)
+		return olms_exchange(filp, (struct olms_exchange __user *)arg);
+	if (cmd_nr >= ARRAY_SIZE(olms_cmd_table) || !olms_cmd_table[cmd_nr])
+		return -ENOTTY;
+
 	err = copy_from_user(&udata, (void __user *)arg, sizeof(udata));
 	if (err) {
 		return -EFAULT;
@@ -807,6 +1082,7 @@ static long olms_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 
 static int olms_open(struct inode *inode, struct file *filp)
 {
+	olms_set_seen(filp, READ_ONCE(shm_page->generation));
 	olms_enabled = true;
 	/*
 	 * log = vzalloc(sizeof(log[0]) * MAX_LOG_ENTRY);
@@ -845,6 +1121,7 @@ static ssize_t olms_read(struct file *fp, char __user *u,
 		printk(KERN_NOTICE "copy to user failed.");
 		return -EFAULT;
 	}
+	olms_set_seen(fp, READ_ONCE(shm_page->generation));
 	printk(KERN_INFO "get bandwidth, rtt, n_subflow measurements.\n");
 	return 0;
 }
@@ -863,12 +1140,45 @@ static ssize_t olms_write(struct file *fp, const char __user *u,
 	return 0;
 }
 
+/* Map the measurement page read-only, see olms-shm.h */
+static int olms_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (vma->vm_pgoff != 0 || size > PAGE_SIZE)
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	/*
+	 * The mapping holds a reference to the page, unlike remap_pfn_range(),
+	 * so the page outlives the module while a process still maps it.
+	 */
+	return vm_insert_page(vma, vma->vm_start, virt_to_page(shm_page));
+}
+
+/*
+ * Readable while the page has a publication that this file has not seen,
+ * i.e. newer than its open, read or last exchange, so that poll() and
+ * level-triggered epoll sleep until the next publication.
+ */
+static __poll_t olms_poll(struct file *filp, poll_table *wait)
+{
+	poll_wait(filp, &olms_wait, wait);
+
+	return READ_ONCE(shm_page->generation) != olms_seen(filp) ?
+	       EPOLLIN | EPOLLRDNORM : 0;
+}
+
 static const struct file_operations olms_fops = {
 	.owner = THIS_MODULE,
 	/* .llseek = olms_llseek, */
 	.read = olms_read,
 	.write = olms_write,
 	.unlocked_ioctl = olms_ioctl,
+	.mmap = olms_mmap,
+	.poll = olms_poll,
 	.open = olms_open,
 	.release = olms_close,
 };
@@ -926,6 +1236,7 @@ struct mptcp_sched_ops mptcp_sched_olms = {
 	.get_subflow = olms_get_available_subflow,
 	.next_segment = mptcp_olms_next_segment,
 	.init = olmssched_init,
+	.release = olmssched_release,
 	.name = "olms",
 	.owner = THIS_MODULE,
 };
@@ -934,17 +1245,39 @@ static int __init olms_register(void)
 {
 	BUILD_BUG_ON(sizeof(struct olmssched_priv) > MPTCP_SCHED_SIZE);
 	/* BUILD_BUG_ON(sizeof(struct olmssched_cb) > MPTCP_SCHED_DATA_SIZE); */
+	BUILD_BUG_ON(sizeof(struct olms_shm_page) > OLMS_SHM_SIZE);
+	BUILD_BUG_ON(OLMS_SHM_SIZE > PAGE_SIZE);
 
-	if (mptcp_register_scheduler(&mptcp_sched_olms))
+	shm_page = (struct olms_shm_page *)get_zeroed_page(GFP_KERNEL);
+	if (!shm_page)
+		return -ENOMEM;
+	olms_shm_init(shm_page);
+
+	if (mptcp_register_scheduler(&mptcp_sched_olms)) {
+		free_page((unsigned long)shm_page);
 		return -1;
+	}
 	/* also register the char device. */
 	olms_setup_cdev(&olms_dev);
 	return 0;
 }
 
+static void olms_remove_cdev(struct olms_dev *olms_dev)
+{
+	device_destroy(cl, devno);
+	class_destroy(cl);
+	cdev_del(&olms_dev->cdev);
+	unregister_chrdev_region(devno, 1);
+}
+
 static void olms_unregister(void)
 {
+	olms_remove_cdev(&olms_dev);
 	mptcp_unregister_scheduler(&mptcp_sched_olms);
+	synchronize_rcu();
+	kfree(rcu_dereference_protected(olms_pref, 1));
+	/* the last mapping, if any, frees the page */
+	free_page((unsigned long)shm_page);
 }
 
 module_init(olms_register);
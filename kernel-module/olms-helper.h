@@ -1,6 +1,8 @@
 #ifndef _OLMS_HELPER_H_
 #define _OLMS_HELPER_H_
 
+#include <linux/types.h>
+
 struct olms_cmd_args {
 	union {
 		unsigned long start;
@@ -32,6 +34,7 @@ enum OLMS_CMD {
 	OLMS_CMD_GET_RTT = 4,
 	OLMS_CMD_GET_BW = 5,
 	OLMS_CMD_PREFER = 6,
+	OLMS_CMD_EXCHANGE = 7,
 };
 
 #define OLMS_IOC_MAGIC 0xCA
@@ -49,6 +52,68 @@ enum OLMS_CMD {
 	_IOWR(OLMS_IOC_MAGIC, OLMS_CMD_GET_BW, struct olms_cmd_args)
 #define OLMS_IOC_PREFER                                                        \
 	_IOWR(OLMS_IOC_MAGIC, OLMS_CMD_PREFER, struct olms_cmd_args)
-#define OLMS_IOC_MAXNR 6
+#define OLMS_IOC_EXCHANGE                                                      \
+	_IOWR(OLMS_IOC_MAGIC, OLMS_CMD_EXCHANGE, struct olms_exchange)
+#define OLMS_IOC_MAXNR 7
+
+/*
+ * The measurement page of the target connection, mapped read-only by
+ * mmap() of /dev/olms at offset 0. The kernel publishes it under the
+ * sequence counter seq (odd while it writes), see olms-shm.h.
+ */
+#define OLMS_SHM_VERSION 1
+#define OLMS_SHM_SIZE 4096
+#define OLMS_SHM_MAX_SUBFLOWS 64
+
+struct olms_shm_subflow {
+	__u32 rtt_us;		/* smoothed rtt */
+	__u32 bw;		/* delivery rate, bytes per second */
+	__u32 lost;		/* packets lost, cumulative */
+	__u32 delivered;	/* packets delivered, cumulative */
+};
+
+struct olms_shm_page {
+	__u32 version;
+	__u32 seq;
+	/* bumped once per publication */
+	__u32 generation;
+	/* highest path index published, entries 0 .. num_subflows - 1 */
+	__u32 num_subflows;
+	__u32 num_established;
+	__u32 reserved;
+	/* bit pi - 1 is set if subflow pi has an entry */
+	__u64 valid_bits;
+	/* entry pi - 1 is the subflow of path index pi */
+	struct olms_shm_subflow subflow[OLMS_SHM_MAX_SUBFLOWS];
+};
+
+/*
+ * OLMS_IOC_EXCHANGE sets the preferred subflows and returns the
+ * generation of the measurement page they apply from; the page itself is
+ * read through the mapping. With count > 1 it queues a batch: the
+ * first set applies now and each later one at the next publication of
+ * new samples, i.e. one per round.
+ *
+ * With a nonzero weight on some subflow the scheduler splits the data
+ * over the available weighted subflows in proportion to their weights,
+ * for the whole batch, and falls back to the preferred sets only when no
+ * weighted subflow is available.
+ */
+#define OLMS_EXCHANGE_VERSION 3
+#define OLMS_EXCHANGE_MAX_BATCH 16
+/* the weight of a share of 1 */
+#define OLMS_WEIGHT_SCALE (1U << 16)
+
+struct olms_exchange {
+	/* in */
+	__u32 version;
+	__u32 count;
+	/* bit pi - 1 prefers the subflow of path index pi */
+	__u64 prefer_bits[OLMS_EXCHANGE_MAX_BATCH];
+	/* weight pi - 1 is the weight of path index pi, 0 for none */
+	__u32 weights[OLMS_SHM_MAX_SUBFLOWS];
+	/* out, as in struct olms_shm_page */
+	__u32 generation;	/* when the first set applied */
+};
 
 #endif /* _OLMS_HELPER_H_ */
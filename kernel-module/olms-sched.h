@@ -0,0 +1,178 @@
+#ifndef _OLMS_SCHED_H_
+#define _OLMS_SCHED_H_
+
+/*
+ * Subflow choice of the scheduler under the preference of userspace.
+ *
+ * A preference is a batch of masks; bit pi - 1 of a mask prefers path
+ * index pi. Mask i of a batch holds from the i-th publication of the
+ * measurement page after the batch was set, the last mask from then on.
+ *
+ * A scheduling decision is
+ *
+ *	olms_choice_init(&c, mask, weights, drr);
+ *	olms_choice_consider(&c, sk, pi, srtt);	for every available subflow
+ *	sk = olms_choice_result(&c);
+ *
+ * which picks the preferred subflow of minimum srtt, or the subflow of
+ * minimum srtt when no preferred one is available.
+ *
+ * With weights, the choice is by deficit round robin over the available
+ * weighted subflows: the one with the largest deficit sends, and
+ *
+ *	olms_choice_charge(&c, bytes);
+ *
+ * once the size of the segment is known credits every candidate its
+ * share of bytes and debits the sender what was credited, so that the
+ * rounding does not move the deficits of the candidates away from those
+ * of the subflows that are not. The bytes on each subflow
+ * follow the weights while the candidates stay available; the deficits
+ * are clamped, so a subflow that was unavailable for long does not get a
+ * burst when it comes back. The preference is the fallback when no
+ * weighted subflow is available.
+ *
+ * The file is plain C without locks, so it builds in userspace like
+ * olms-shm.h.
+ */
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/bitops.h>
+#include <linux/math64.h>
+#include <uapi/linux/olms-helper.h>
+
+#define olms_ffs64(x) __ffs64(x)
+#define olms_div64(a, b) div64_u64(a, b)
+#else
+#include <stddef.h>
+#include "olms-helper.h"
+
+#define olms_ffs64(x) __builtin_ctzll(x)
+#define olms_div64(a, b) ((a) / (b))
+#endif
+
+/* bytes a deficit may run ahead or behind */
+#define OLMS_DRR_MAX_DEFICIT (1 << 22)
+
+/* the mask of a batch of count masks, since publications after it was set */
+static inline __u64 olms_pref_mask(const __u64 *masks, __u32 count,
+				   __u32 since)
+{
+	if (!count)
+		return 0;
+	return masks[since < count ? since : count - 1];
+}
+
+static inline int olms_pref_has(__u64 mask, int pi)
+{
+	if (pi < 1 || pi > OLMS_SHM_MAX_SUBFLOWS)
+		return 0;
+	return (mask >> (pi - 1)) & 1;
+}
+
+/* the deficits in bytes of the subflows of a connection */
+struct olms_drr {
+	__s64 deficit[OLMS_SHM_MAX_SUBFLOWS];
+};
+
+struct olms_choice {
+	__u64 mask;
+	void *best;
+	__u32 best_srtt;
+	void *pref;
+	__u32 pref_srtt;
+	/* deficit round robin, if weights */
+	const __u32 *weights;
+	struct olms_drr *drr;
+	__u64 candidates;
+	__u64 weight_sum;
+	void *next;
+	int next_pi;
+};
+
+/* weights of OLMS_SHM_MAX_SUBFLOWS subflows and their drr, or NULL */
+static inline void olms_choice_init(struct olms_choice *c, __u64 mask,
+				    const __u32 *weights,
+				    struct olms_drr *drr)
+{
+	c->mask = mask;
+	c->best = NULL;
+	c->best_srtt = 0xffffffff;
+	c->pref = NULL;
+	c->pref_srtt = 0xffffffff;
+	c->weights = drr ? weights : NULL;
+	c->drr = drr;
+	c->candidates = 0;
+	c->weight_sum = 0;
+	c->next = NULL;
+	c->next_pi = 0;
+}
+
+/* start over with the same preference */
+static inline void olms_choice_reset(struct olms_choice *c)
+{
+	olms_choice_init(c, c->mask, c->weights, c->drr);
+}
+
+static inline void olms_choice_consider(struct olms_choice *c, void *sk,
+					int pi, __u32 srtt)
+{
+	if (srtt < c->best_srtt) {
+		c->best_srtt = srtt;
+		c->best = sk;
+	}
+	if (srtt < c->pref_srtt && olms_pref_has(c->mask, pi)) {
+		c->pref_srtt = srtt;
+		c->pref = sk;
+	}
+	if (c->weights && pi >= 1 && pi <= OLMS_SHM_MAX_SUBFLOWS &&
+	    c->weights[pi - 1]) {
+		c->candidates |= 1ULL << (pi - 1);
+		c->weight_sum += c->weights[pi - 1];
+		if (!c->next ||
+		    c->drr->deficit[pi - 1] > c->drr->deficit[c->next_pi - 1]) {
+			c->next = sk;
+			c->next_pi = pi;
+		}
+	}
+}
+
+static inline void *olms_choice_result(const struct olms_choice *c)
+{
+	if (c->next)
+		return c->next;
+	return c->pref ? c->pref : c->best;
+}
+
+static inline void olms_drr_clamp(__s64 *deficit)
+{
+	if (*deficit > OLMS_DRR_MAX_DEFICIT)
+		*deficit = OLMS_DRR_MAX_DEFICIT;
+	else if (*deficit < -OLMS_DRR_MAX_DEFICIT)
+		*deficit = -OLMS_DRR_MAX_DEFICIT;
+}
+
+/* the result sends bytes; nothing to do unless it came from the weights */
+static inline void olms_choice_charge(const struct olms_choice *c,
+				      __u32 bytes)
+{
+	__u64 candidates = c->candidates;
+	__s64 credited = 0, share;
+	int i, sender = c->next_pi - 1;
+
+	if (!c->next)
+		return;
+	while (candidates) {
+		i = olms_ffs64(candidates);
+		candidates &= candidates - 1;
+		share = olms_div64((__u64)bytes * c->weights[i], c->weight_sum);
+		c->drr->deficit[i] += share;
+		credited += share;
+		if (i != sender)
+			olms_drr_clamp(&c->drr->deficit[i]);
+	}
+	c->drr->deficit[sender] -= credited;
+	olms_drr_clamp(&c->drr->deficit[sender]);
+}
+
+#endif /* _OLMS_SCHED_H_ */
@@ -0,0 +1,158 @@
+#ifndef _OLMS_SHM_H_
+#define _OLMS_SHM_H_
+
+/*
+ * Seqlock protocol of the measurement page, struct olms_shm_page.
+ *
+ * The kernel is the only writer: it publishes from the scheduler of the
+ * target connection, which runs under the meta socket lock. A
+ * publication is
+ *
+ *	olms_shm_write_begin(page);
+ *	olms_shm_set_subflow(page, pi, ...);	for every subflow
+ *	olms_shm_write_end(page, num_subflows, num_established);
+ *
+ * Userspace reads a consistent copy with olms_shm_read(), without a
+ * system call; it retries while a publication is in progress.
+ *
+ * The file is shared by the module and the user program, and builds in
+ * userspace with the compiler's atomics in place of the kernel's.
+ */
+
+#ifdef __KERNEL__
+#include <linux/compiler.h>
+#include <linux/string.h>
+#include <asm/barrier.h>
+#include <asm/processor.h>
+#include <uapi/linux/olms-helper.h>
+
+#define OLMS_READ_ONCE(x) READ_ONCE(x)
+#define OLMS_WRITE_ONCE(x, v) WRITE_ONCE(x, v)
+#define olms_wmb() smp_wmb()
+#define olms_rmb() smp_rmb()
+#define olms_cpu_relax() cpu_relax()
+#else
+#include <string.h>
+#include "olms-helper.h"
+
+#define OLMS_READ_ONCE(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define OLMS_WRITE_ONCE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+#define olms_wmb() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define olms_rmb() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#if defined(__x86_64__) || defined(__i386__)
+#define olms_cpu_relax() __builtin_ia32_pause()
+#else
+#define olms_cpu_relax() do { } while (0)
+#endif
+#endif
+
+static inline void olms_shm_init(struct olms_shm_page *page)
+{
+	memset(page, 0, sizeof(*page));
+	page->version = OLMS_SHM_VERSION;
+}
+
+static inline void olms_shm_write_begin(struct olms_shm_page *page)
+{
+	OLMS_WRITE_ONCE(page->seq, page->seq + 1);
+	olms_wmb();
+	OLMS_WRITE_ONCE(page->valid_bits, 0);
+}
+
+/* path index pi starts from 1 */
+static inline void olms_shm_set_subflow(struct olms_shm_page *page, int pi,
+					__u32 rtt_us, __u32 bw, __u32 lost,
+					__u32 delivered)
+{
+	struct olms_shm_subflow *s;
+
+	if (pi < 1 || pi > OLMS_SHM_MAX_SUBFLOWS)
+		return;
+	s = &page->subflow[pi - 1];
+	OLMS_WRITE_ONCE(s->rtt_us, rtt_us);
+	OLMS_WRITE_ONCE(s->bw, bw);
+	OLMS_WRITE_ONCE(s->lost, lost);
+	OLMS_WRITE_ONCE(s->delivered, delivered);
+	OLMS_WRITE_ONCE(page->valid_bits, page->valid_bits | (1ULL << (pi - 1)));
+}
+
+static inline void olms_shm_write_end(struct olms_shm_page *page,
+				      __u32 num_subflows, __u32 num_established)
+{
+	if (num_subflows > OLMS_SHM_MAX_SUBFLOWS)
+		num_subflows = OLMS_SHM_MAX_SUBFLOWS;
+	OLMS_WRITE_ONCE(page->num_subflows, num_subflows);
+	OLMS_WRITE_ONCE(page->num_established, num_established);
+	OLMS_WRITE_ONCE(page->generation, page->generation + 1);
+	olms_wmb();
+	OLMS_WRITE_ONCE(page->seq, page->seq + 1);
+}
+
+/*
+ * Has subflow pi changed since it was published? The writer reads its
+ * own page, so no barrier is needed.
+ */
+static inline int olms_shm_subflow_changed(const struct olms_shm_page *page,
+					   int pi, __u32 rtt_us, __u32 delivered)
+{
+	const struct olms_shm_subflow *s;
+
+	if (pi < 1 || pi > OLMS_SHM_MAX_SUBFLOWS)
+		return 0;
+	if (!(page->valid_bits & (1ULL << (pi - 1))))
+		return 1;
+	s = &page->subflow[pi - 1];
+	return s->rtt_us != rtt_us || s->delivered != delivered;
+}
+
+static inline __u32 olms_shm_read_begin(const struct olms_shm_page *page)
+{
+	__u32 seq;
+
+	while ((seq = OLMS_READ_ONCE(page->seq)) & 1)
+		olms_cpu_relax();
+	olms_rmb();
+	return seq;
+}
+
+static inline int olms_shm_read_retry(const struct olms_shm_page *page,
+				      __u32 seq)
+{
+	olms_rmb();
+	return OLMS_READ_ONCE(page->seq) != seq;
+}
+
+/*
+ * Copy the header and the published subflows of the page into out, which
+ * is private to the caller. Returns the number of attempts.
+ */
+static inline int olms_shm_read(const struct olms_shm_page *page,
+				struct olms_shm_page *out)
+{
+	__u32 seq, i, n;
+	int attempts = 0;
+
+	do {
+		seq = olms_shm_read_begin(page);
+		++attempts;
+		out->version = OLMS_READ_ONCE(page->version);
+		out->seq = seq;
+		out->generation = OLMS_READ_ONCE(page->generation);
+		n = OLMS_READ_ONCE(page->num_subflows);
+		if (n > OLMS_SHM_MAX_SUBFLOWS)
+			n = OLMS_SHM_MAX_SUBFLOWS;
+		out->num_subflows = n;
+		out->num_established = OLMS_READ_ONCE(page->num_established);
+		out->valid_bits = OLMS_READ_ONCE(page->valid_bits);
+		for (i = 0; i < n; i++) {
+			out->subflow[i].rtt_us = OLMS_READ_ONCE(page->subflow[i].rtt_us);
+			out->subflow[i].bw = OLMS_READ_ONCE(page->subflow[i].bw);
+			out->subflow[i].lost = OLMS_READ_ONCE(page->subflow[i].lost);
+			out->subflow[i].delivered = OLMS_READ_ONCE(page->subflow[i].delivered);
+		}
+	} while (olms_shm_read_retry(page, seq));
+
+	return attempts;
+}
+
+#endif /* _OLMS_SHM_H_ */
@@ -0,0 +1,253 @@
+/*
+ * The subflow choice of olms-sched.h in userspace, on stand-in subflows
+ * considered as the scheduler does: the preferred subflow wins over a
+ * faster one, the fastest of the preferred wins, the fastest of all is
+ * the fallback, and a batch applies its masks by the publications since
+ * it was set. With weights, the bytes follow the shares and the deficits
+ * stay clamped. Then the cost of a decision.
+ *
+ *	olms-test-sched
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "olms-sched.h"
+
+#define DECISIONS 20000000
+#define SEGMENTS 1000000
+
+#define CHECK(x)							\
+	do {								\
+		if (!(x)) {						\
+			fprintf(stderr, "FAILED: %s:%d: %s\n",		\
+				__FILE__, __LINE__, #x);		\
+			failures++;					\
+		}							\
+	} while (0)
+
+/* the fields of a subflow that the scheduler considers */
+struct subflow_standin {
+	int pi;
+	__u32 srtt;
+	int available;
+};
+
+static int failures;
+static struct olms_drr drr;
+
+static __attribute__((noinline)) struct subflow_standin *
+choose(struct subflow_standin *s, int n, __u64 mask)
+{
+	struct olms_choice c;
+	int i;
+
+	olms_choice_init(&c, mask, NULL, NULL);
+	for (i = 0; i < n; i++)
+		if (s[i].available)
+			olms_choice_consider(&c, &s[i], s[i].pi, s[i].srtt);
+	return olms_choice_result(&c);
+}
+
+/* a decision under weights, charged with the segment of bytes */
+static struct subflow_standin *transmit(struct subflow_standin *s, int n,
+				    __u64 mask, const __u32 *weights,
+				    __u32 bytes)
+{
+	struct olms_choice c;
+	struct subflow_standin *sk;
+	int i;
+
+	olms_choice_init(&c, mask, weights, &drr);
+	for (i = 0; i < n; i++)
+		if (s[i].available)
+			olms_choice_consider(&c, &s[i], s[i].pi, s[i].srtt);
+	sk = olms_choice_result(&c);
+	if (sk)
+		olms_choice_charge(&c, bytes);
+	return sk;
+}
+
+static __s64 max_deficit(void)
+{
+	__s64 max = 0;
+	int i;
+
+	for (i = 0; i < OLMS_SHM_MAX_SUBFLOWS; i++)
+		if (llabs(drr.deficit[i]) > max)
+			max = llabs(drr.deficit[i]);
+	return max;
+}
+
+/* the mask of olms_choice_start() at page generation g */
+static __u64 batch_mask(const __u64 *masks, __u32 count, __u32 set_at,
+			__u32 g)
+{
+	return olms_pref_mask(masks, count, g - set_at);
+}
+
+static void test_choice(void)
+{
+	struct subflow_standin s[4] = {
+		{ 1, 300, 1 }, { 2, 100, 1 }, { 3, 200, 1 }, { 4, 50, 0 },
+	};
+	int i;
+
+	/* no preference: the minimum srtt */
+	CHECK(choose(s, 4, 0) == &s[1]);
+	/* the preferred subflow over a faster one */
+	CHECK(choose(s, 4, 1ULL << 0) == &s[0]);
+	/* the minimum srtt among the preferred */
+	CHECK(choose(s, 4, 1ULL << 0 | 1ULL << 2) == &s[2]);
+	/* the preferred one unavailable, or no such subflow: the fallback */
+	CHECK(choose(s, 4, 1ULL << 3) == &s[1]);
+	CHECK(choose(s, 4, 1ULL << 63) == &s[1]);
+	s[3].available = 1;
+	CHECK(choose(s, 4, 1ULL << 3) == &s[3]);
+	for (i = 0; i < 4; i++)
+		s[i].available = 0;
+	CHECK(choose(s, 4, 1ULL << 0) == NULL);
+
+	CHECK(!olms_pref_has(~0ULL, 0));
+	CHECK(olms_pref_has(~0ULL, OLMS_SHM_MAX_SUBFLOWS));
+	CHECK(!olms_pref_has(~0ULL, OLMS_SHM_MAX_SUBFLOWS + 1));
+}
+
+static void test_batch(void)
+{
+	const __u64 masks[3] = { 1, 4, 8 };
+	const __u32 set_at = 0xfffffffe;
+
+	/* mask i from the i-th publication, the last one from then on */
+	CHECK(batch_mask(masks, 3, 7, 7) == 1);
+	CHECK(batch_mask(masks, 3, 7, 8) == 4);
+	CHECK(batch_mask(masks, 3, 7, 9) == 8);
+	CHECK(batch_mask(masks, 3, 7, 1000) == 8);
+	/* across the wrap of the generation */
+	CHECK(batch_mask(masks, 3, set_at, set_at) == 1);
+	CHECK(batch_mask(masks, 3, set_at, set_at + 1) == 4);
+	CHECK(batch_mask(masks, 3, set_at, 0) == 8);
+	CHECK(batch_mask(masks, 3, set_at, 5) == 8);
+	/* a single set, and none */
+	CHECK(batch_mask(masks, 1, 7, 9) == 1);
+	CHECK(batch_mask(masks, 0, 7, 7) == 0);
+}
+
+/*
+ * Weights .5, .3 and .2 on path indices 1, 2 and 5; path index 6 is the
+ * fastest but has no weight. Segments of random size.
+ */
+static void test_drr(void)
+{
+	struct subflow_standin s[4] = {
+		{ 1, 100, 1 }, { 2, 200, 1 }, { 5, 300, 1 }, { 6, 50, 1 },
+	};
+	__u32 weights[OLMS_SHM_MAX_SUBFLOWS] = { 0 };
+	double sent[4] = { 0 }, total = 0;
+	__s64 max = 0;
+	long i, run = 0, longest = 0;
+
+	weights[0] = OLMS_WEIGHT_SCALE / 2;
+	weights[1] = OLMS_WEIGHT_SCALE * 3 / 10;
+	weights[4] = OLMS_WEIGHT_SCALE / 5;
+	srand(1);
+	for (i = 0; i < SEGMENTS; i++) {
+		__u32 bytes = 1 + rand() % 65000;
+		struct subflow_standin *sk = transmit(s, 4, 0, weights, bytes);
+
+		sent[sk - s] += bytes;
+		total += bytes;
+		if (max_deficit() > max)
+			max = max_deficit();
+	}
+	printf("shares %.3f %.3f %.3f %.3f, max |deficit| %lld\n",
+	       sent[0] / total, sent[1] / total, sent[2] / total,
+	       sent[3] / total, (long long)max);
+	CHECK(fabs(sent[0] / total - 0.5) < 0.005);
+	CHECK(fabs(sent[1] / total - 0.3) < 0.005);
+	CHECK(fabs(sent[2] / total - 0.2) < 0.005);
+	CHECK(sent[3] == 0);
+	CHECK(max <= OLMS_DRR_MAX_DEFICIT);
+
+	/*
+	 * Path index 5 unavailable for long: the others share in proportion
+	 * to their weights, and it comes back without a burst.
+	 */
+	sent[0] = sent[1] = sent[2] = total = 0;
+	s[2].available = 0;
+	for (i = 0; i < SEGMENTS; i++) {
+		struct subflow_standin *sk = transmit(s, 4, 0, weights, 1500);
+
+		sent[sk - s] += 1500;
+		total += 1500;
+	}
+	CHECK(fabs(sent[0] / total - 0.625) < 0.005);
+	CHECK(fabs(sent[1] / total - 0.375) < 0.005);
+	s[2].available = 1;
+	for (i = 0; i < 1000; i++) {
+		run = transmit(s, 4, 0, weights, 1500) == &s[2] ? run + 1 : 0;
+		if (run > longest)
+			longest = run;
+	}
+	printf("longest run of path index 5 after its return: %ld segments\n",
+	       longest);
+	CHECK(longest <= 2);
+
+	/* a huge segment: the deficits stay clamped */
+	memset(&drr, 0, sizeof(drr));
+	CHECK(transmit(s, 4, 0, weights, 0xffffffff) == &s[0]);
+	CHECK(drr.deficit[0] == -OLMS_DRR_MAX_DEFICIT);
+	CHECK(drr.deficit[1] == OLMS_DRR_MAX_DEFICIT);
+	CHECK(drr.deficit[4] == OLMS_DRR_MAX_DEFICIT);
+	CHECK(max_deficit() <= OLMS_DRR_MAX_DEFICIT);
+
+	/* no weighted subflow available: the preference, then the fastest */
+	s[0].available = s[1].available = s[2].available = 0;
+	CHECK(transmit(s, 4, 1ULL << 5, weights, 1500) == &s[3]);
+	CHECK(transmit(s, 4, 0, weights, 1500) == &s[3]);
+	CHECK(max_deficit() <= OLMS_DRR_MAX_DEFICIT);
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* a decision over 16 subflows with moving srtts, as per packet */
+static void bench_choice(void)
+{
+	struct subflow_standin s[16];
+	void *volatile sink;
+	double t;
+	long i;
+
+	for (i = 0; i < 16; i++) {
+		s[i].pi = i + 1;
+		s[i].srtt = 1000 + (i * 7919) % 500;
+		s[i].available = 1;
+	}
+	t = now_ns();
+	for (i = 0; i < DECISIONS; i++) {
+		s[i & 15].srtt ^= 1;
+		sink = choose(s, 16, 0x1111ULL << (i & 3));
+	}
+	(void)sink;
+	printf("%.1f ns per decision over 16 subflows\n",
+	       (now_ns() - t) / DECISIONS);
+}
+
+int main(void)
+{
+	test_choice();
+	test_batch();
+	test_drr();
+	bench_choice();
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+/*
+ * The seqlock protocol of olms-shm.h in userspace: a writer thread
+ * publishes stand-in subflows as the scheduler does, while the reader
+ * checks that every copy is consistent, i.e. all its fields come from the
+ * same publication. Then the cost of an uncontended read.
+ *
+ *	olms-test-shm [seconds]
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "olms-shm.h"
+
+#define NUM_SUBFLOWS 8
+#define READS 10000000
+
+/* the fields of struct tcp_sock that the scheduler publishes */
+struct tcp_sock_standin {
+	__u32 srtt_us;		/* << 3 as in the kernel */
+	__u32 rate_delivered;
+	__u32 rate_interval_us;
+	__u32 mss_cache;
+	__u32 lost;
+	__u32 delivered;
+};
+
+static struct olms_shm_page page __attribute__((aligned(4096)));
+static volatile int stop;
+
+static __u32 delivery_rate(const struct tcp_sock_standin *tp)
+{
+	if (!tp->rate_interval_us)
+		return 0;
+	return (__u64)tp->rate_delivered * tp->mss_cache * 1000000 /
+	       tp->rate_interval_us;
+}
+
+/* publication g: subflow i has rtt g + i, lost g, delivered 10 g */
+static void *writer(void *arg)
+{
+	struct tcp_sock_standin tp[NUM_SUBFLOWS];
+	__u32 g;
+	int i;
+
+	(void)arg;
+	for (g = 1; !stop; g++) {
+		for (i = 0; i < NUM_SUBFLOWS; i++) {
+			tp[i].srtt_us = (g + i) << 3;
+			tp[i].rate_delivered = 10;
+			tp[i].rate_interval_us = 1000;
+			tp[i].mss_cache = 1400;
+			tp[i].lost = g;
+			tp[i].delivered = g * 10;
+		}
+		olms_shm_write_begin(&page);
+		for (i = 0; i < NUM_SUBFLOWS; i++)
+			olms_shm_set_subflow(&page, i + 1, tp[i].srtt_us >> 3,
+					     delivery_rate(&tp[i]), tp[i].lost,
+					     tp[i].delivered);
+		olms_shm_write_end(&page, NUM_SUBFLOWS, NUM_SUBFLOWS);
+	}
+	return NULL;
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* the number of fields of snap that do not belong to its publication */
+static long torn_fields(const struct olms_shm_page *snap)
+{
+	__u32 g = snap->generation, i;
+	long torn = 0;
+
+	for (i = 0; i < snap->num_subflows; i++) {
+		const struct olms_shm_subflow *s = &snap->subflow[i];
+
+		torn += s->rtt_us != g + i;
+		torn += s->lost != g;
+		torn += s->delivered != g * 10;
+		torn += s->bw != 14000000;
+	}
+	torn += snap->num_subflows && snap->valid_bits != (1ULL << NUM_SUBFLOWS) - 1;
+	return torn;
+}
+
+int main(int argc, char **argv)
+{
+	double seconds = argc > 1 ? atof(argv[1]) : 1, start, t;
+	struct olms_shm_page snap;
+	long reads = 0, attempts = 0, torn = 0, i;
+	pthread_t w;
+
+	olms_shm_init(&page);
+	if (pthread_create(&w, NULL, writer, NULL)) {
+		fprintf(stderr, "cannot start the writer\n");
+		return EXIT_FAILURE;
+	}
+	start = now_ns();
+	while (now_ns() - start < seconds * 1e9) {
+		attempts += olms_shm_read(&page, &snap);
+		reads++;
+		torn += torn_fields(&snap);
+	}
+	stop = 1;
+	pthread_join(w, NULL);
+	printf("contended: %ld reads, %.2f attempts per read, %ld torn fields, %u publications\n",
+	       reads, (double)attempts / reads, torn, page.generation);
+
+	t = now_ns();
+	for (i = 0; i < READS; i++)
+		olms_shm_read(&page, &snap);
+	printf("uncontended: %.1f ns per read of %d subflows\n",
+	       (now_ns() - t) / READS, NUM_SUBFLOWS);
+
+	if (torn || page.seq & 1 || torn_fields(&snap) ||
+	    snap.generation != page.generation) {
+		fprintf(stderr, "FAILED: inconsistent reads\n");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
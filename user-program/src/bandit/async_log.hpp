@@ -0,0 +1,261 @@
+#pragma once
+
+#include "macro_util.h"
+#include "bandit_util.hpp"
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+
+namespace bandit {
+
+// what the control loop reports, each level includes the previous ones
+enum LogLevel {
+    LOG_QUIET = 0,
+    LOG_SELECTION = 1, // the selected paths of every round
+    LOG_MEASUREMENT = 2 // the kernel measurements of every round
+};
+
+enum LogRecordType {
+    LOG_SELECTED_PATHS,
+    LOG_RTT_RAW,
+    LOG_RTT_REL,
+    LOG_BW_RAW,
+    LOG_BW_REL,
+    LOG_LOSS_RATE
+};
+
+// records in the ring, when it is full the control loop drops records
+const size_t LOG_RING_CAPACITY = 4096;
+// idle time of the drain thread when the ring is empty
+const int LOG_DRAIN_INTERVAL_US = 1000;
+
+// a fixed-size binary record, formatted by the drain thread
+struct LogRecord {
+    uint32_t type;
+    uint32_t policy;
+    uint32_t round;
+    uint32_t count;
+    union {
+        uint32_t ids[MAX_NUM_PATHS];
+        double values[MAX_NUM_PATHS];
+    };
+};
+
+// Lock-free ring for one producer and one consumer. The producer fills
+// the slot returned by claim() and makes it visible with publish(); the
+// consumer reads front() and releases it with pop().
+template<class T>
+class SPSCRing {
+    std::vector<T> slots;
+    const size_t mask;
+    // next slot to write, only changed by the producer
+    alignas(64) std::atomic<size_t> head;
+    // next slot to read, only changed by the consumer
+    alignas(64) std::atomic<size_t> tail;
+
+public:
+    // capacity is rounded up to a power of two
+    explicit SPSCRing(size_t capacity)
+            :slots(roundUp(capacity)), mask(roundUp(capacity)-1), head(0), tail(0)
+    {
+    }
+
+    // a free slot, or NULL if the ring is full
+    T* claim()
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h-tail.load(std::memory_order_acquire)>mask) {
+            return NULL;
+        }
+        return &slots[h & mask];
+    }
+
+    void publish()
+    {
+        head.store(head.load(std::memory_order_relaxed)+1, std::memory_order_release);
+    }
+
+    // the oldest record, or NULL if the ring is empty
+    const T* front()
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t==head.load(std::memory_order_acquire)) {
+            return NULL;
+        }
+        return &slots[t & mask];
+    }
+
+    void pop()
+    {
+        tail.store(tail.load(std::memory_order_relaxed)+1, std::memory_order_release);
+    }
+
+private:
+    static size_t roundUp(size_t n)
+    {
+        size_t p = 1;
+        while (p<n) {
+            p <<= 1;
+        }
+        return p;
+    }
+};
+
+// The control loop writes records into a ring and never waits: when the
+// ring is full the record is dropped and counted. A background thread
+// drains the ring to a file ("-" is stdout), or discards it ("").
+class AsyncLog {
+    int level;
+    SPSCRing<LogRecord> ring;
+    std::FILE* out;
+    std::thread drainer;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> dropped;
+
+public:
+    AsyncLog()
+            :level(LOG_QUIET), ring(LOG_RING_CAPACITY), out(NULL), running(false), dropped(0)
+    {
+    }
+
+    ~AsyncLog()
+    {
+        stop();
+    }
+
+    // call once, before the control loop starts
+    void start(int verbosity, const std::string& file)
+    {
+        level = verbosity;
+        if (level==LOG_QUIET) {
+            return;
+        }
+        if (file=="-") {
+            out = stdout;
+        }
+        else if (!file.empty()) {
+            out = std::fopen(file.c_str(), "w");
+            if (out==NULL) {
+                std::cerr << "AsyncLog: cannot open " << file << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        running = true;
+        drainer = std::thread(&AsyncLog::drain, this);
+    }
+
+    // drain what is left and join the background thread
+    void stop()
+    {
+        if (!running) {
+            return;
+        }
+        running = false;
+        drainer.join();
+        if (dropped>0) {
+            std::cerr << "AsyncLog: " << dropped << " records dropped" << std::endl;
+        }
+        if (out!=NULL && out!=stdout) {
+            std::fclose(out);
+        }
+        else if (out==stdout) {
+            std::fflush(stdout);
+        }
+        out = NULL;
+    }
+
+    bool enabled(int verbosity) const
+    {
+        return level>=verbosity;
+    }
+
+    void logSelection(uint p, uint t, const std::vector<uint>& is)
+    {
+        if (!enabled(LOG_SELECTION)) {
+            return;
+        }
+        LogRecord* r = claim(LOG_SELECTED_PATHS, p, t, is.size());
+        if (r!=NULL) {
+            for (uint i = 0; i<r->count; ++i) {
+                r->ids[i] = is[i];
+            }
+            ring.publish();
+        }
+    }
+
+    template<class T>
+    void logValues(LogRecordType type, const T* values, size_t n)
+    {
+        if (!enabled(LOG_MEASUREMENT)) {
+            return;
+        }
+        LogRecord* r = claim(type, 0, 0, n);
+        if (r!=NULL) {
+            for (uint i = 0; i<r->count; ++i) {
+                r->values[i] = values[i];
+            }
+            ring.publish();
+        }
+    }
+
+private:
+    LogRecord* claim(LogRecordType type, uint p, uint t, size_t n)
+    {
+        LogRecord* r = ring.claim();
+        if (r==NULL) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return NULL;
+        }
+        r->type = type;
+        r->policy = p;
+        r->round = t;
+        r->count = std::min<size_t>(n, MAX_NUM_PATHS);
+        return r;
+    }
+
+    void drain()
+    {
+        for (;;) {
+            // read the flag first, so nothing published before stop() is lost
+            const bool last = !running.load(std::memory_order_acquire);
+            const LogRecord* r;
+            while ((r = ring.front())!=NULL) {
+                if (out!=NULL) {
+                    write(*r);
+                }
+                ring.pop();
+            }
+            if (last) {
+                break;
+            }
+            if (out!=NULL) {
+                std::fflush(out);
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(LOG_DRAIN_INTERVAL_US));
+        }
+    }
+
+    void write(const LogRecord& r)
+    {
+        static const char* const names[] = {
+                "Selected path ID:", "#rtt-raw:", "#rtt-rel:", "#bw-raw:", "#bw-rel:", "#lossrate:"
+        };
+        std::fputs(names[r.type], out);
+        for (uint i = 0; i<r.count; ++i) {
+            if (r.type==LOG_SELECTED_PATHS) {
+                std::fprintf(out, " %u", r.ids[i]);
+            }
+            else {
+                std::fprintf(out, " %g", r.values[i]);
+            }
+        }
+        std::fputc('\n', out);
+    }
+};
+
+// the log of the control loop
+AsyncLog olmsLog;
+
+} //namespace
@@ -1,6 +1,7 @@
 
 #pragma once
 #include "macro_util.h"
+#include "rng.hpp"
 #include <vector>
 #include <array>
 #include <string>
@@ -17,22 +18,33 @@
 #include <cmath>
 #include <ctime>
 #include <cfloat>
+#include <cstdint>
 
 namespace bandit {
 
 typedef unsigned int uint;
 
+// the largest number of paths, a set of selected paths fits in a uint64_t
+const int MAX_NUM_PATHS = 64;
+
 typedef std::vector<std::vector<double> > vec2Double;
 
 typedef std::vector<std::vector<std::vector<double> > > vec3Double;
-typedef std::vector<std::vector<std::vector<uint> > > vec3Uint;
 
 const double pi = 3.14159265;
 
 const double e = 2.718281828;
 
-//RNG engine
-std::mt19937 randomEngine(std::time(0));
+//RNG engine, one per thread; the Simulator selects the stream before
+//every call into a policy or a path
+thread_local PhiloxEngine randomEngine(std::time(0));
+
+// key the engine of this thread for run `run` of an experiment, the
+// numbers drawn in a run only depend on (seed, run)
+void seedRun(uint32_t seed, uint32_t run)
+{
+    randomEngine.setKey(seed, run);
+}
 
 double bernoulliTrial(double rand, double mu)
 {
@@ -97,9 +109,9 @@ struct Metric {
 
 };
 
-typedef std::vector<std::vector<std::vector<Metric> > > vec3Metric;
-
-void printMsg(const std::string& msg)
+// the debug printers take C strings, the literal is not copied into a
+// std::string on every call when DEBUG_mode is off
+void printMsg(const char* msg)
 {
 #if DEBUG_mode
     std::cout << msg << std::endl;
@@ -107,10 +119,10 @@ void printMsg(const std::string& msg)
 }
 
 template<class T>
-void printVec(const std::string& name, const std::vector<T>& vec)
+void printVec(const char* name, const std::vector<T>& vec)
 {
 #if DEBUG_mode
-    std::cout << name+": ";
+    std::cout << name << ": ";
     for (const auto& i:vec) {
         std::cout << i << " ";
     }
@@ -129,10 +141,10 @@ void printVecR(const std::string& name, const std::vector<T>& vec)
 }
 
 template<class T>
-void printVar(const std::string& name, const T& var)
+void printVar(const char* name, const T& var)
 {
 #if DEBUG_mode
-    std::cout << name+": ";
+    std::cout << name << ": ";
     std::cout << var << " ";
     std::cout << std::endl;
 #endif
@@ -152,35 +164,88 @@ uint vectorMaxIndex(const std::vector<T>& elems)
     return m;
 }
 
+// the insertion array of topIndices is used up to this l
+const uint TOP_INSERTION_MAX = 8;
+
+// The indices of the l smallest keys into is, in ascending order of the
+// key; the key of elems[i] is -elems[i] if largest. Equal keys are in
+// index order, as with a stable sort. A small l keeps the l best in a
+// sorted array that an element only enters if it beats the last one.
+// Otherwise all indices are stable sorted in order; up to K=64 that is
+// faster than nth_element over (key, index) pairs and a sort of the l best.
+template<bool largest, class T>
+void topIndices(const std::vector<T>& elems, uint l, std::vector<uint>& order, std::vector<uint>& is)
+{
+    const uint K = (uint) elems.size();
+    l = std::min(l, K);
+    is.clear();
+    if (l==0) {
+        return;
+    }
+    if (l<=TOP_INSERTION_MAX) {
+        T keys[TOP_INSERTION_MAX];
+        uint ids[TOP_INSERTION_MAX];
+        uint n = 0;
+        for (uint i = 0; i<K; ++i) {
+            const T key = largest ? -elems[i] : elems[i];
+            if (n==l) {
+                // strict, an equal key has a higher index
+                if (!(key<keys[l-1])) {
+                    continue;
+                }
+                --n;
+            }
+            uint j = n;
+            for (; j>0 && key<keys[j-1]; --j) {
+                keys[j] = keys[j-1];
+                ids[j] = ids[j-1];
+            }
+            keys[j] = key;
+            ids[j] = i;
+            ++n;
+        }
+        is.assign(ids, ids+l);
+        return;
+    }
+    order.resize(K);
+    for (uint i = 0; i<K; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&elems](uint a, uint b) {
+        return largest ? elems[a]>elems[b] : elems[a]<elems[b];
+    });
+    is.assign(order.begin(), order.begin()+l);
+}
+
+// the indices of the l largest elements into is, order is a buffer
+template<class T>
+void vectorMaxIndices(const std::vector<T>& elems, uint l, std::vector<uint>& order, std::vector<uint>& is)
+{
+    topIndices<true>(elems, l, order, is);
+}
+
 template<class T>
 std::vector<uint> vectorMaxIndices(const std::vector<T>& elems, uint l)
 {
-    std::vector<std::pair<T, uint>> elemPairs;
-    for (uint i = 0; i<elems.size(); ++i) {
-        elemPairs.push_back(std::make_pair(-elems[i], i));
-    }
-    std::stable_sort(elemPairs.begin(), elemPairs.end());
+    std::vector<uint> order;
     std::vector<uint> is;
-    uint i = 0;
-    for (auto it = elemPairs.begin(); (it!=elemPairs.end()) && (i<l); ++it, ++i) {
-        is.push_back(it->second);
-    }
+    vectorMaxIndices(elems, l, order, is);
     return is;
 }
 
+// the indices of the l smallest elements into is, order is a buffer
+template<class T>
+void vectorMinIndices(const std::vector<T>& elems, uint l, std::vector<uint>& order, std::vector<uint>& is)
+{
+    topIndices<false>(elems, l, order, is);
+}
+
 template<class T>
 std::vector<uint> vectorMinIndices(const std::vector<T>& elems, uint l)
 {
-    std::vector<std::pair<T, uint>> elemPairs;
-    for (uint i = 0; i<elems.size(); ++i) {
-        elemPairs.push_back(std::make_pair(elems[i], i));// reverse the sign
-    }
-    std::stable_sort(elemPairs.begin(), elemPairs.end());
+    std::vector<uint> order;
     std::vector<uint> is;
-    uint i = 0;
-    for (auto it = elemPairs.begin(); (it!=elemPairs.end()) && (i<l); ++it, ++i) {
-        is.push_back(it->second);
-    }
+    vectorMinIndices(elems, l, order, is);
     return is;
 }
 
@@ -261,18 +326,25 @@ std::string dtos(double number)
     return ss.str();
 }
 
-//randomly sort 1,...,K
-std::vector<uint> randomIndices(uint K)
+//randomly sort 1,...,K into rvec, temp is a buffer
+void randomIndices(uint K, std::vector<std::pair<double, uint>>& temp, std::vector<uint>& rvec)
 {
-    std::vector<std::pair<double, uint>> temp;
+    temp.clear();
     for (uint i = 0; i<K; ++i) {
         temp.push_back(std::make_pair(std::uniform_real_distribution<double>(0.0, 1.0)(randomEngine), i));
     }
     std::sort(temp.begin(), temp.end());
-    std::vector<uint> rvec;
+    rvec.clear();
     for (uint i = 0; i<K; ++i) {
         rvec.push_back(temp[i].second);
     }
+}
+
+std::vector<uint> randomIndices(uint K)
+{
+    std::vector<std::pair<double, uint>> temp;
+    std::vector<uint> rvec;
+    randomIndices(K, temp, rvec);
     return rvec;
 }
 
@@ -395,106 +467,110 @@ std::string doubleSetToString(std::set<double> s)
     return astr;
 }
 
-std::vector<uint> dependentRounding(uint l, std::vector<double> ps)
+// buffers of dependentRounding, kept by the caller between rounds
+struct RoundingScratch {
+    // the fractional entries, in random order
+    std::vector<uint> fractional;
+    std::vector<int> selected;
+    std::vector<double> uniforms;
+};
+
+// Dependent rounding of Gandhi et al., "Dependent rounding and its
+// applications to approximation algorithms" (JACM 2006): selects exactly
+// l items, item i with probability probs[i]. Each step pairs two
+// fractional items and moves probability between them until one is 0 or
+// 1, so the sum stays l and every marginal is preserved. The fractional
+// items are shuffled once and paired in that order, carrying the one left
+// fractional into the next pair, so a call is O(K).
+void dependentRounding(uint l, const std::vector<double>& probs, RoundingScratch& scratch,
+        std::vector<uint>& selectedPaths)
 {
-    uint K = (uint) ps.size();
+    const uint K = (uint) probs.size();
     printMsg("DependentRounding start");
-    if (std::abs(vectorSum(ps)-l)>0.001) {
+    if (std::abs(vectorSum(probs)-l)>0.001) {
 
-        std::cerr << "Error: probability sum is not equal to " << l << " (" << vectorSum(ps) << ")"
+        std::cerr << "Error: probability sum is not equal to " << l << " (" << vectorSum(probs) << ")"
                   << std::endl;
         abort();
     }
-    std::vector<int> selected(K, -1); //-1-> not determined 0->not selected 1->selected
+    std::vector<int>& selected = scratch.selected;
+    std::vector<uint>& fractional = scratch.fractional;
+    selected.resize(K); //0->not selected 1->selected
+    fractional.clear();
     for (uint i = 0; i<K; ++i) {
-        if (ps[i]>0.999) {
+        if (probs[i]>0.999) {
             selected[i] = 1;
         }
-        else if (ps[i]<0.001) {
+        else if (probs[i]<0.001) {
             selected[i] = 0;
         }
-    }
-    std::vector<uint> randIndices = randomIndices(K);
-    while (true) {
-        std::pair<uint, uint> ij;
-        bool iSelected = false;
-        bool iSelected2 = false;
-        uint i;
-        for (i = 0; i<K; ++i) {
-            //std::cout << "itemp=" << i << std::endl;
-            uint ind = randIndices[i];
-            if (!iSelected) {
-                if (selected[ind]==-1) {
-                    ij.first = ind;
-                    iSelected = true;
-                }
-            }
-            else {
-                if (selected[ind]==-1) {
-                    ij.second = ind;
-                    iSelected2 = true;
-                    break;
-                }
-            }
-        }
-        if ((i==K) && (iSelected==false)) {
-            break;
-        }
-        if (i==K && (!iSelected2)) {
-            if (ps[ij.first]>0.5) {
-                selected[ij.first] = 1;
-            }
-            else {
-                selected[ij.first] = 0;
-            }
-            break;
-        }
-        std::pair<double, double> pij;
-        pij.first = ps[ij.first];
-        pij.second = ps[ij.second];
-        double alpha = std::min(1-pij.first, pij.second);
-        double beta = std::min(pij.first, 1-pij.second);
-        double prob = beta/(alpha+beta);
-        double rand = std::uniform_real_distribution<double>(0.0, 1.0)(randomEngine);
-        double pin, pjn;
-        if (rand<prob) {
-            pin = pij.first+alpha;
-            pjn = pij.second-alpha;
-        }
         else {
-            pin = pij.first-beta;
-            pjn = pij.second+beta;
-        }
-        if (pin>0.999) {
-            selected[ij.first] = 1;
+            fractional.push_back(i);
         }
-        else if (pin<0.001) {
-            selected[ij.first] = 0;
-        }
-        else {
-            ps[ij.first] = pin;
-        }
-        if (pjn>0.999) {
-            selected[ij.second] = 1;
+    }
+    const uint n = (uint) fractional.size();
+    if (n>0) {
+        // n-1 uniforms for the shuffle, n-1 for the pairs
+        std::vector<double>& u = scratch.uniforms;
+        u.resize(2*n);
+        randomEngine.fillUniform(u);
+        for (uint i = 0; i+1<n; ++i) {
+            const uint j = std::min(n-1, i+(uint) (u[i]*(n-i)));
+            std::swap(fractional[i], fractional[j]);
         }
-        else if (pjn<0.001) {
-            selected[ij.second] = 0;
+        // the item carried into the next pair and its probability
+        uint cur = fractional[0];
+        double pcur = probs[cur];
+        bool carried = true;
+        for (uint k = 1; k<n; ++k) {
+            const uint next = fractional[k];
+            const double pnext = probs[next];
+            if (!carried) {
+                cur = next;
+                pcur = pnext;
+                carried = true;
+                continue;
+            }
+            const double alpha = std::min(1-pcur, pnext);
+            const double beta = std::min(pcur, 1-pnext);
+            // the outcome is random, so the step is written without branches
+            const bool up = u[n+k-1]*(alpha+beta)<beta;
+            const double pin = up ? pcur+alpha : pcur-beta;
+            const double pjn = up ? pnext-alpha : pnext+beta;
+            const bool curDone = (pin>0.999) | (pin<0.001);
+            const bool nextDone = (pjn>0.999) | (pjn<0.001);
+            // one of the two is now 0 or 1 and the other one is carried;
+            // the carried one is written again later
+            selected[cur] = pin>0.5;
+            selected[next] = pjn>0.5;
+            carried = !(curDone & nextDone);
+            cur = curDone ? next : cur;
+            pcur = curDone ? pjn : pin;
         }
-        else {
-            ps[ij.second] = pjn;
+        // only left fractional by rounding errors of the sum
+        if (carried) {
+            selected[cur] = pcur>0.5 ? 1 : 0;
         }
     }
-    std::vector<uint> selectedPaths;
+    selectedPaths.resize(K);
+    uint m = 0;
     for (uint i = 0; i<K; ++i) {
-        if (selected[i]==1) {
-            selectedPaths.push_back(i);
-        }
+        selectedPaths[m] = i;
+        m += selected[i];
     }
+    selectedPaths.resize(m);
     if (selectedPaths.size()!=l) {
         std::cerr << "Error: " << selectedPaths.size() << " selected (should be " << l << " )." << std::endl;
         abort();
     }
     printMsg("DependentRounding end!");
+}
+
+std::vector<uint> dependentRounding(uint l, std::vector<double> ps)
+{
+    RoundingScratch scratch;
+    std::vector<uint> selectedPaths;
+    dependentRounding(l, ps, scratch, selectedPaths);
     return selectedPaths;
 }
 
@@ -131,5 +131,114 @@ std::basic_istream<CharT>& operator>>(std::basic_istream<CharT>& is,
     return is;
 }
 
+// Batch Beta sampling for the Thompson-sampling policies.
+//
+// Beta(a, b) with integer a, b and a+b-1 <= BETA_ORDER_STAT_MAX is the
+// a-th smallest of a+b-1 uniforms. Other parameters go through two gamma
+// samples, X/(X+Y), drawn with the method of Marsaglia and Tsang, "A
+// simple method for generating gamma variables" (2000). All gamma lanes
+// are first tried in one branch-free pass over pre-drawn uniforms, and
+// only the few rejected lanes are redrawn one at a time.
+
+// the order statistic is cheaper than two gamma samples up to this size
+const int BETA_ORDER_STAT_MAX = 8;
+
+const double TWO_PI = 6.283185307179586;
+
+// buffers of sampleBeta, kept by the caller between rounds
+struct BetaScratch {
+    // gamma shapes, a and b of every gamma lane interleaved
+    std::vector<double> shape;
+    std::vector<double> gamma;
+    std::vector<double> uniforms;
+    // outputs sampled through the gamma lanes
+    std::vector<uint> lanes;
+};
+
+// one Marsaglia-Tsang trial for the shape a >= 1 from the uniforms u[0..2],
+// returns -1 if it is rejected
+inline double gammaTrial(double a, const double* u)
+{
+    const double d = a-1.0/3.0;
+    const double c = 1.0/std::sqrt(9.0*d);
+    const double z = std::sqrt(-2.0*std::log(1.0-u[0]))*std::cos(TWO_PI*u[1]);
+    const double t = 1.0+c*z;
+    const double v = t*t*t;
+    const bool accept = v>0 && (u[2]<1.0-0.0331*(z*z)*(z*z)
+            || std::log(u[2])<0.5*z*z+d*(1.0-v+std::log(v)));
+    return accept ? d*v : -1.0;
+}
+
+// out[i] ~ Gamma(shape[i], 1) for i < n, with u as a buffer
+inline void sampleGammaBatch(const double* shape, size_t n, double* out, PhiloxEngine& engine,
+        std::vector<double>& u)
+{
+    // four uniforms per lane: the normal, the acceptance test and the
+    // boost U^(1/a) of the shapes below 1
+    u.resize(4*n);
+    engine.fillUniform(u);
+    for (size_t i = 0; i<n; ++i) {
+        out[i] = gammaTrial(shape[i]<1.0 ? shape[i]+1.0 : shape[i], &u[4*i]);
+    }
+    for (size_t i = 0; i<n; ++i) {
+        const double a = shape[i]<1.0 ? shape[i]+1.0 : shape[i];
+        double r[4];
+        while (out[i]<0) {
+            engine.fillUniform(r, 3);
+            out[i] = gammaTrial(a, r);
+        }
+        if (shape[i]<1.0) {
+            out[i] *= std::pow(1.0-u[4*i+3], 1.0/shape[i]);
+        }
+    }
+}
+
+inline bool isSmallIntegerBeta(double a, double b)
+{
+    return a>=1 && b>=1 && a+b-1<=BETA_ORDER_STAT_MAX && a==std::floor(a) && b==std::floor(b);
+}
+
+// the a-th smallest of a+b-1 uniforms
+inline double sampleBetaOrderStat(int a, int b, PhiloxEngine& engine)
+{
+    double u[BETA_ORDER_STAT_MAX];
+    const int n = a+b-1;
+    engine.fillUniform(u, n);
+    std::nth_element(u, u+a-1, u+n);
+    return u[a-1];
+}
+
+// out[i] ~ Beta(a[i], b[i]) for every i
+inline void sampleBeta(const std::vector<double>& a, const std::vector<double>& b, std::vector<double>& out,
+        PhiloxEngine& engine, BetaScratch& scratch)
+{
+    const size_t n = a.size();
+    out.resize(n);
+    // sized for all lanes, the number of gamma lanes grows with the counts
+    scratch.lanes.reserve(n);
+    scratch.shape.reserve(2*n);
+    scratch.gamma.reserve(2*n);
+    scratch.uniforms.reserve(8*n);
+    scratch.lanes.clear();
+    scratch.shape.clear();
+    for (size_t i = 0; i<n; ++i) {
+        if (isSmallIntegerBeta(a[i], b[i])) {
+            out[i] = sampleBetaOrderStat((int) a[i], (int) b[i], engine);
+        }
+        else {
+            scratch.lanes.push_back(i);
+            scratch.shape.push_back(a[i]);
+            scratch.shape.push_back(b[i]);
+        }
+    }
+    scratch.gamma.resize(scratch.shape.size());
+    sampleGammaBatch(scratch.shape.data(), scratch.shape.size(), scratch.gamma.data(), engine, scratch.uniforms);
+    for (size_t j = 0; j<scratch.lanes.size(); ++j) {
+        const double x = scratch.gamma[2*j];
+        const double y = scratch.gamma[2*j+1];
+        out[scratch.lanes[j]] = x/(x+y);
+    }
+}
+
 } //namespace
 
@@ -5,21 +5,22 @@
 #include "../path/path_bernoulli.hpp"
 #include "../path/path_fixvalue.hpp"
 #include "../path/path_kernel.hpp"
+#include "../path/path_replay.hpp"
 #include "../policy/policy.hpp"
-#include "../policy/policy_conmpts_latency.hpp"
-#include "../policy/policy_mpts.hpp"
-#include "../policy/policy_klucb.hpp"
-#include "../policy/policy_exp3m.hpp"
-#include "../policy/policy_random.hpp"
+#include "../policy/policy_factory.hpp"
 #include "bandit_util.hpp"
 #ifdef OLMS_KERNEL
 #include "kernel_util.hpp"
 #endif
 #include "simulator.hpp"
+#include "streamlog.hpp"
 
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 namespace bandit {
 
@@ -51,18 +52,26 @@ void initPaths(std::vector<PathPtr>& paths, const std::string& paraFile)
     }
 }
 
+// the paths of a trace recorded with --record, one per column
+void initReplayPaths(std::vector<PathPtr>& paths, const std::string& traceFile)
+{
+    paths.clear();
+    std::shared_ptr<const TraceReader> trace(new TraceReader(traceFile));
+    std::cout << "# Replaying " << trace->getRounds() << " rounds of " << trace->getK() << " paths from "
+              << traceFile << std::endl;
+    for (uint i = 0; i<trace->getK(); ++i) {
+        paths.push_back(PathPtr(new ReplayPath(trace, i)));
+    }
+}
+
 #ifdef OLMS_KERNEL
 void initKernelPaths(std::vector<PathPtr>& paths, uint M, uint num_paths)
 {
-    int ret;
-
-    // wait for enough number of paths
-    std::cout << "# Waiting for target MPTCP flow " << kcmpts.getNumPaths()
+    // wait for enough number of paths, woken when the subflows change
+    std::cout << "# Waiting for target MPTCP flow " << kolms.getNumPaths()
               << std::endl;
-    while ((ret = kcmpts.getNumPaths())<num_paths) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
-    std::cout << "# Num paths: " << kcmpts.getNumPaths() << std::endl;
+    kolms.waitForPaths(num_paths);
+    std::cout << "# Num paths: " << kolms.getNumPaths() << std::endl;
 
     for (int i = 0; i<num_paths; i++) {
         paths.push_back(PathPtr(new KernelPath({0, 1, 0}, i)));
@@ -70,11 +79,11 @@ void initKernelPaths(std::vector<PathPtr>& paths, uint M, uint num_paths)
 }
 #endif
 
-// initialize the policies
-void initPolicies(std::vector<PolicyPtr>& policies, uint K, double threshold, double damping_factor)
+// initialize the policies of a comma separated list of specs, see PolicySpec
+void initPolicies(std::vector<PolicyPtr>& policies, uint K, const std::string& specs,
+        const PolicyDefaults& defaults)
 {
-    policies.clear();
-    policies.push_back(PolicyPtr(new ConMPTSLatency(K, threshold, damping_factor)));
+    policies = PolicyFactory::createAll(specs, K, defaults);
 #if DEBUG_mode
     for (auto p : policies) {
         std::cout << "# Init: " << p->info() << "" << std::endl;
@@ -83,36 +92,179 @@ void initPolicies(std::vector<PolicyPtr>& policies, uint K, double threshold, do
 
 }
 
-// start simulation
+// Simulate on fresh copies of the paths and policies, which are of the
+// types PathT and PolicyT. The copies are owned through the base classes,
+// whose virtual destructors delete them. Returns the decision time of
+// every policy.
+template<class PolicyT, class PathT, class Log>
+std::vector<DecisionTime> simulateCopies(Log& log, const uint T, const uint M, const double threshold,
+        const std::vector<PathPtr>& paths,
+        const std::vector<PolicyPtr>& policies,
+        const uint delta_t)
+{
+    std::vector<std::shared_ptr<PathT>> runPaths;
+    for (const auto& path : paths) {
+        runPaths.push_back(std::static_pointer_cast<PathT>(PathPtr(path->clone())));
+    }
+    std::vector<std::shared_ptr<PolicyT>> runPolicies;
+    for (const auto& policy : policies) {
+        runPolicies.push_back(std::static_pointer_cast<PolicyT>(PolicyPtr(policy->clone())));
+    }
+    Simulator<PolicyT, PathT, Log> pathSelectionSim(runPaths, runPolicies, M, threshold, delta_t);
+    pathSelectionSim.runSimulation(log, T);
+    return pathSelectionSim.getDecisionTimes();
+}
+
+bool allPathsOfType(const std::vector<PathPtr>& paths, PathType type)
+{
+    for (const auto& path : paths) {
+        if (path->getType()!=type) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Run `run` of an experiment on fresh copies of the paths and policies,
+// so that every run starts from the same state and its random numbers
+// only depend on (seed, run). The controller of the kernel mode, a single
+// ConMPTSLatency, runs on a simulator specialized for it.
+template<class Log>
+std::vector<DecisionTime> runOnce(Log& log, const uint run, const uint32_t seed, const uint T,
+        const uint M, const double threshold,
+        const std::vector<PathPtr>& paths,
+        const std::vector<PolicyPtr>& policies,
+        const uint delta_t)
+{
+    seedRun(seed, run);
+    if (policies.size()!=1 || policies[0]->getType()!=PolicyType::CONMPTS_Latency) {
+        return simulateCopies<Policy, Path>(log, T, M, threshold, paths, policies, delta_t);
+    }
+#ifdef OLMS_KERNEL
+    else if (allPathsOfType(paths, PathType::KERNEL)) {
+        return simulateCopies<ConMPTSLatency, KernelPath>(log, T, M, threshold, paths, policies, delta_t);
+    }
+#endif
+    else {
+        return simulateCopies<ConMPTSLatency, Path>(log, T, M, threshold, paths, policies, delta_t);
+    }
+}
+
+void mergeDecisionTimes(std::vector<DecisionTime>& total, const std::vector<DecisionTime>& run)
+{
+    total.resize(run.size());
+    for (uint p = 0; p<run.size(); ++p) {
+        total[p].merge(run[p]);
+    }
+}
+
+void printDecisionTimes(const std::vector<std::string>& policyNames, const std::vector<DecisionTime>& times)
+{
+    std::cout << "# Decision time per round (us): policy mean max" << std::endl;
+    for (uint p = 0; p<times.size(); ++p) {
+        std::cout << "# " << policyNames[p] << " " << std::fixed << std::setprecision(3)
+                  << times[p].meanUs() << " " << times[p].maxNs/1000 << std::endl;
+    }
+    std::cout.unsetf(std::ios_base::floatfield);
+}
+
+// The runs are shared out to the worker threads, each one simulates into
+// its own log. The run logs are merged in run order, so the result does
+// not depend on the number of threads.
+void runSimulations(RoundwiseFullLog& log, const uint simulationTimes, const uint threads,
+        const uint32_t seed, const uint T, const uint M, const double threshold,
+        const std::vector<PathPtr>& paths,
+        const std::vector<PolicyPtr>& policies,
+        const uint delta_t,
+        std::vector<DecisionTime>& decisionTimes)
+{
+    std::atomic<uint> nextRun(0);
+    uint merged = 0;
+    std::mutex mergeMutex;
+    std::condition_variable mergeTurn;
+
+    auto worker = [&]() {
+        RoundwiseFullLog runLog(log.P, log.T, log.K, log.forever);
+        for (uint run = nextRun++; run<simulationTimes; run = nextRun++) {
+            runLog.clear();
+            std::vector<DecisionTime> runTimes = runOnce(runLog, run, seed, T, M, threshold, paths, policies,
+                    delta_t);
+            std::unique_lock<std::mutex> lock(mergeMutex);
+            mergeTurn.wait(lock, [&]() { return merged==run; });
+            log.merge(runLog);
+            mergeDecisionTimes(decisionTimes, runTimes);
+            ++merged;
+            mergeTurn.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (uint i = 1; i<threads; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+// start simulation, the rounds are streamed to streamFile if it is given
 void startSimulation(const uint simulationTimes, const uint T,
         const uint M, const double threshold,
         const std::vector<PathPtr>& paths,
         const std::vector<PolicyPtr>& policies,
         const std::string& logFile,
         const uint delta_t,
-        const bool isForever)
+        const bool isForever,
+        const std::string& streamFile = "",
+        const uint32_t seed = 0,
+        uint threads = 1)
 {
     uint P = policies.size();
     uint K = paths.size();
 
-    RoundwiseFullLog log(P, T, K, isForever);
+    // the kernel paths, the stream and the forever mode are single-threaded
+    if (threads==0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (!streamFile.empty() || isForever || (K>0 && paths[0]->getType()==PathType::KERNEL)) {
+        threads = 1;
+    }
+    threads = std::min(threads, std::max(simulationTimes, 1u));
+
+    std::vector<std::string> policyNames;
+    policyNames.reserve(policies.size());
+    for (const auto& iPolicy : policies) {
+        policyNames.push_back(iPolicy->name());
+    }
 
-    for (uint i = 0; i<simulationTimes; ++i) {
-        Simulator<RoundwiseFullLog> pathSelectionSim(paths, policies, M, threshold, delta_t);
-        pathSelectionSim.runSimulation(log, T);
+    if (!streamFile.empty()) {
+        StreamingLog log(P, T, K, isForever, streamFile, policyNames);
+        std::vector<DecisionTime> decisionTimes;
+        for (uint run = 0; run<simulationTimes; ++run) {
+            mergeDecisionTimes(decisionTimes, runOnce(log, run, seed, T, M, threshold, paths, policies, delta_t));
+        }
+        log.close();
+        printDecisionTimes(policyNames, decisionTimes);
+        std::cout << "Number of selected paths: " << M << std::endl;
+        std::cout << "Round log streamed to: " << streamFile << " (average it with olms-logavg)" << std::endl;
+        return;
     }
 
+    RoundwiseFullLog log(P, T, K, isForever);
+    if (threads>1) {
+        std::cout << "Running " << simulationTimes << " simulations on " << threads << " threads" << std::endl;
+    }
+    std::vector<DecisionTime> decisionTimes;
+    runSimulations(log, simulationTimes, threads, seed, T, M, threshold, paths, policies, delta_t, decisionTimes);
+    printDecisionTimes(policyNames, decisionTimes);
+
     std::cout << "Number of selected paths: " << M << std::endl;
     std::vector<std::string> pathNames;
     pathNames.reserve(paths.size());
     for (const auto& iPath : paths) {
         pathNames.push_back(iPath->printInfo());
     }
-    std::vector<std::string> policyNames;
-    policyNames.reserve(policies.size());
-    for (const auto& iPolicy : policies) {
-        policyNames.push_back(iPolicy->name());
-    }
     std::cout << "Output reward and violation in: " << logFile << std::endl;
     RoundwiseFullLogWriter::fullLogWrite(log, T, policyNames, logFile);
 }
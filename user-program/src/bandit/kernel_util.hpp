@@ -6,6 +6,7 @@
 #include <cmath>
 #include <ctime>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <map>
@@ -17,210 +18,324 @@
 #include <string>
 #include <vector>
 
+#include <thread>
+
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <cerrno>
+
+#include "bandit_util.hpp"
+#include "async_log.hpp"
+#include "trace.hpp"
 
 #define CONSTANT_BOUND 1
 
+// the longest wait for the kernel before the state is checked again (us)
+#define OLMS_WAIT_RECHECK_US 1000000
+
 extern "C" {
 #include "olms-helper.h"
+#include "olms-shm.h"
 }
 
 namespace bandit {
 
-const int MAX_NUM_PATHS = 64;
-
 struct OLMSKernel {
+    // does the OLMS_IOC_EXCHANGE of a stand-in for the module
+    typedef std::function<int(struct olms_exchange& args)> Exchanger;
+
+    // the relative rtt, bandwidth and loss rate of the paths with a sample
     std::vector<double> rvec;
     std::vector<double> bvec;
     std::vector<double> lvec;
     uint num_paths;
     uint max_rtt;
     uint max_btlbw;
+    // push the fractional selection of the policies as subflow weights
+    bool split;
+    // opened on first use, so that the other path types run without the module
     int fd;
+    // the measurement page of the kernel, mapped on first use
+    const struct olms_shm_page* page;
+    // woken by the publications of the page
+    int epfd;
+    // the generation of the page at the last fetch
+    uint32_t lastGeneration;
+    // the measurements of every round, with --record
+    std::unique_ptr<TraceWriter> recorder;
+    // in place of the ioctl, when attached to a stand-in
+    Exchanger exchanger;
 
     OLMSKernel(void)
             :rvec(MAX_NUM_PATHS, 0), bvec(MAX_NUM_PATHS, 0),
-             lvec(MAX_NUM_PATHS, 0), max_rtt(0), fd(0)
+             lvec(MAX_NUM_PATHS, 0), max_rtt(0), split(false), fd(-1), page(NULL), epfd(-1), lastGeneration(0),
+             numValid(0), rawRtt(MAX_NUM_PATHS, 0), rawBw(MAX_NUM_PATHS, 0),
+             pathIndex(MAX_NUM_PATHS, 0), prevLost(OLMS_SHM_MAX_SUBFLOWS, 0),
+             prevDelivered(OLMS_SHM_MAX_SUBFLOWS, 0)
+    {
+    }
+
+    int device(void)
     {
-        fd = open("/dev/olms", O_RDWR);
         if (fd==-1) {
-            std::cerr << "Failed to open kernel interface" << std::endl;
-            exit(EXIT_FAILURE);
+            fd = open("/dev/olms", O_RDWR);
+            if (fd==-1) {
+                std::cerr << "Failed to open kernel interface" << std::endl;
+                exit(EXIT_FAILURE);
+            }
         }
+        return fd;
     }
 
-    void set_num_paths(uint v) { num_paths = v; }
-    void set_max_rtt(uint v) { max_rtt = v; }
-    void set_max_btlbw(uint v) { max_btlbw = v; }
+    const struct olms_shm_page* sharedPage(void)
+    {
+        if (page==NULL) {
+            void* p = mmap(NULL, OLMS_SHM_SIZE, PROT_READ, MAP_SHARED, device(), 0);
+            if (p==MAP_FAILED) {
+                std::cerr << "Failed to map the measurement page of the kernel interface" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            page = static_cast<const struct olms_shm_page*>(p);
+            if (page->version!=OLMS_SHM_VERSION) {
+                std::cerr << "Measurement page version " << page->version << ", expected "
+                          << OLMS_SHM_VERSION << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        return page;
+    }
 
-    unsigned long getNumPaths(void)
+    // Use fd and page in place of /dev/olms and its page: anything that
+    // polls readable on a publication, e.g. an eventfd in a stand-in, which
+    // also takes the exchanges.
+    void attach(int fd_, const struct olms_shm_page* page_, const Exchanger& exchanger_)
     {
-        struct olms_cmd_args args = {0};
-        int ret;
+        fd = fd_;
+        page = page_;
+        exchanger = exchanger_;
+    }
 
-        ret = ioctl(fd, OLMS_IOC_NUMPATHS, &args);
-        if (ret==-1) {
-            // std::cerr << "ioctl NUMPATHS failed" << std::endl;
-            return 0;
+    int events(void)
+    {
+        if (epfd==-1) {
+            struct epoll_event ev = {};
+            // a wakeup per publication, the page tells what is new
+            ev.events = EPOLLIN | EPOLLET;
+            ev.data.fd = device();
+            epfd = epoll_create1(EPOLL_CLOEXEC);
+            if (epfd==-1 || epoll_ctl(epfd, EPOLL_CTL_ADD, device(), &ev)==-1) {
+                std::cerr << "Failed to poll the kernel interface" << std::endl;
+                exit(EXIT_FAILURE);
+            }
         }
-        return args.len;
+        return epfd;
     }
 
-    int fetchMeasurements(void)
+    // Waits until the page has a publication newer than the last fetch, at
+    // most timeout_us. Returns false on a timeout.
+    bool waitForSample(uint timeout_us)
     {
-        struct olms_cmd_args args = {0};
-        std::vector<uint>* rtt_vec, * bw_vec;
+        const int timeout_ms = (timeout_us+999)/1000;
+        // checked before sleeping, a publication after the check still wakes
+        while (OLMS_READ_ONCE(sharedPage()->generation)==lastGeneration) {
+            struct epoll_event ev;
+            int n = epoll_wait(events(), &ev, 1, timeout_ms);
+            if (n==0) {
+                return false;
+            }
+            if (n<0 && errno!=EINTR) {
+                std::cerr << "epoll_wait on the kernel interface failed" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        return true;
+    }
 
-        // get the lost packets and delivered packets
-        std::vector<uint>* loss_vec, * delivered_vec;
+    // waits until n subflows are established
+    void waitForPaths(uint n)
+    {
+        while (getNumPaths()<n) {
+            lastGeneration = OLMS_READ_ONCE(sharedPage()->generation);
+            waitForSample(OLMS_WAIT_RECHECK_US);
+        }
+    }
 
-        std::vector<double>* rtt_vec_float, * bw_vec_float;
-        std::vector<double>* loss_vec_float;
-        int ret;
-        unsigned long num_paths;
-        uint big_rtt = 0;
+    // append the measurements of the first num_paths paths to a trace
+    // after every fetch, for replaying them with ReplayPath
+    void startRecording(const std::string& file)
+    {
+        recorder.reset(new TraceWriter(file, num_paths));
+    }
 
-        if ((num_paths = getNumPaths())==0)
-            return -2;
+    void stopRecording(void)
+    {
+        recorder.reset();
+    }
 
-        // Pre-allocate, as the kernel will access it directly
-        rtt_vec = new std::vector<uint>(MAX_NUM_PATHS);
-        bw_vec = new std::vector<uint>(MAX_NUM_PATHS);
-        // loss and deliver
-        loss_vec = new std::vector<uint>(MAX_NUM_PATHS);
-        delivered_vec = new std::vector<uint>(MAX_NUM_PATHS);
+    void set_num_paths(uint v) { num_paths = v; }
+    void set_max_rtt(uint v) { max_rtt = v; }
+    void set_max_btlbw(uint v) { max_btlbw = v; }
+    void set_split(bool v) { split = v; }
 
-        args.rtt_vec_addr = (unsigned long) rtt_vec->data();
-        args.bw_vec_addr = (unsigned long) bw_vec->data();
+    // the established subflows, read from the page without a system call
+    unsigned long getNumPaths(void)
+    {
+        return OLMS_READ_ONCE(sharedPage()->num_established);
+    }
 
-        args.loss_vec_addr = (unsigned long) loss_vec->data();
-        // args.delivered_vec_addr = (unsigned long) delivered_vec->data();
+    // Reads the measurements of the subflows that have a sample, in path
+    // index order, from the shared page. Sleeps until the next publication
+    // while fewer than num_paths of them have one. Does not allocate.
+    int fetchMeasurements(void)
+    {
+        const struct olms_shm_page* shared = sharedPage();
+        uint big_rtt = 0;
 
-        retry:
-        ret = ioctl(fd, OLMS_IOC_GET_RTT, &args);
-        if (ret<0) {
-            std::cout << "ioctl GET_RTT failed" << std::endl;
-            return ret;
+        for (;;) {
+            olms_shm_read(shared, &snapshot);
+            lastGeneration = snapshot.generation;
+            if (snapshot.num_established==0) {
+                return -2;
+            }
+            numValid = 0;
+            for (uint i = 0; i<snapshot.num_subflows && numValid<MAX_NUM_PATHS; ++i) {
+                if ((snapshot.valid_bits & (1ULL << i)) && snapshot.subflow[i].rtt_us!=0) {
+                    pathIndex[numValid++] = i;
+                }
+            }
+            if (numValid>=num_paths) {
+                break;
+            }
+            // a path has no sample yet, wait for the next publication
+            waitForSample(OLMS_WAIT_RECHECK_US);
         }
 
-        // Don't pre-allocate, because later I use push_back
-        rtt_vec_float = new std::vector<double>;
-        bw_vec_float = new std::vector<double>;
-        loss_vec_float = new std::vector<double>;
-
         if (!CONSTANT_BOUND) {
-            for (const uint& rtt : *rtt_vec) {
-                if (rtt>big_rtt)
-                    big_rtt = rtt;
+            for (uint j = 0; j<numValid; ++j) {
+                big_rtt = std::max(big_rtt, snapshot.subflow[pathIndex[j]].rtt_us);
             }
             if (big_rtt>max_rtt)
                 max_rtt = big_rtt;
         }
 
-        // ensure at least X paths, and mark unused ones as 0
-#if 1
-        for (int i = 0; i<args.len; i++) {
-            uint rtt = rtt_vec->at(i);
-            if (rtt==0) {
-                continue;
-            }
-            // double rtt_float = (double) rtt/(8.0*max_rtt); // already divide by 8 here!
-            double rtt_float = (double) rtt/(max_rtt); // restored the rtt in kernel
-            if (rtt_float>1.0) {
-                rtt_float = 1.0;
-            }
-            rtt_vec_float->push_back(rtt_float);
-            bw_vec_float->push_back((double) bw_vec->at(i)/max_btlbw);
-            uint delivered_n = delivered_vec->at(i);
-            uint loss_n = loss_vec->at(i);
-            if (delivered_n==0) { // the denominator is 0 ...
-                loss_vec_float->push_back(0.0);
-            }
-            else { // the rtt is valid, and the denominator is not 0
-                loss_vec_float->push_back((1.0*loss_n)/(1.0*delivered_n));
-            }
-
+        for (uint j = 0; j<numValid; ++j) {
+            const uint i = pathIndex[j];
+            const struct olms_shm_subflow& s = snapshot.subflow[i];
+            rawRtt[j] = s.rtt_us;
+            rawBw[j] = s.bw;
+            rvec[j] = std::min((double) s.rtt_us/max_rtt, 1.0);
+            bvec[j] = std::min((double) s.bw/max_btlbw, 1.0);
+            // the loss rate since the last fetch
+            const uint lost = s.lost-prevLost[i];
+            const uint delivered = s.delivered-prevDelivered[i];
+            lvec[j] = delivered==0 ? 0.0 : std::min((double) lost/delivered, 1.0);
+            prevLost[i] = s.lost;
+            prevDelivered[i] = s.delivered;
         }
-#else
-        rtt_vec_float->push_back(rand()%2);
-        rtt_vec_float->push_back(0.3);
-        rtt_vec_float->push_back(0.3);
-        rtt_vec_float->push_back(rand()%2);
-#endif
-        if (rtt_vec_float->size()<num_paths) {
-            /* retry */
-            delete rtt_vec_float;
-            delete bw_vec_float;
-            delete loss_vec_float;
-            goto retry;
-        }
-
-        rvec.swap(*rtt_vec_float);
-        bvec.swap(*bw_vec_float);
-        lvec.swap(*loss_vec_float);
-
-        if (1 /* DEBUG_mode */) {
-            std::cout << "#rtt-raw: ";
-            for (int i = 0; i<args.len; i++) {
-                std::cout << rtt_vec->at(i) << ' ';
-            }
-            std::cout << std::endl;
-            std::cout << "#rtt-rel: ";
-            for (const auto& r : rvec) {
-                std::cout << r << ' ';
-            }
-            std::cout << std::endl;
-            std::cout << "#bw-raw: ";
-            for (int i = 0; i<args.len; i++) {
-                std::cout << bw_vec->at(i) << ' ';
-            }
-            std::cout << std::endl;
-            std::cout << "#bw-rel: ";
-            for (const auto& b : bvec) {
-                std::cout << b << ' ';
-            }
-            std::cout << std::endl;
-            std::cout << "#lossrate: ";
-            for (const auto& l : lvec) {
-                std::cout << l << ' ';
-            }
-            std::cout << std::endl;
-            // std::cout << std::endl;
+        if (recorder) {
+            recorder->append(rvec, bvec, lvec);
         }
 
-        delete rtt_vec;
-        delete bw_vec;
-
-        delete loss_vec;
-        delete delivered_vec;
-        delete loss_vec_float;
-
-        delete rtt_vec_float;
-        delete bw_vec_float;
+        // formatted by the log thread, with --verbose 2
+        olmsLog.logValues(LOG_RTT_RAW, rawRtt.data(), numValid);
+        olmsLog.logValues(LOG_RTT_REL, rvec.data(), numValid);
+        olmsLog.logValues(LOG_BW_RAW, rawBw.data(), numValid);
+        olmsLog.logValues(LOG_BW_REL, bvec.data(), numValid);
+        olmsLog.logValues(LOG_LOSS_RATE, lvec.data(), numValid);
 
         return 0;
     }
 
-    int setPreferredPaths(std::vector<uint>& is, uint K)
+    // user path i is the subflow of path index (K+1)*i+1
+    static uint64_t kernelMask(const std::vector<uint>& is, uint K)
     {
-        // Fix the path mapping
-        std::vector<uint> kernel_path_ids;
+        uint64_t mask = 0;
         for (const auto i : is) {
-            kernel_path_ids.push_back((K+1)*i); // kernel has already plus 1
+            if ((K+1)*i<OLMS_SHM_MAX_SUBFLOWS) {
+                mask |= 1ULL << ((K+1)*i);
+            }
         }
-        // Feed the data to the kernel
-        struct olms_cmd_args args{
-                (unsigned long) kernel_path_ids.data(), 0, kernel_path_ids.size(),
-        };
-        int ret;
+        return mask;
+    }
 
-        ret = ioctl(fd, OLMS_IOC_PREFER, &args);
+    // Sets the preferred paths in one OLMS_IOC_EXCHANGE; the page is read
+    // through the mapping.
+    // masks[0] applies now, each later mask at the next publication. The
+    // next waitForSample() waits for a sample taken after masks[0] applied.
+    // The weights of the subflows, if any, replace the older ones.
+    int exchange(const uint64_t* masks, uint count, const uint32_t* weights = NULL)
+    {
+        if (count<1 || count>OLMS_EXCHANGE_MAX_BATCH) {
+            std::cerr << "exchange: " << count << " preferred sets, at most " << OLMS_EXCHANGE_MAX_BATCH
+                      << std::endl;
+            return -EINVAL;
+        }
+        exchangeArgs.version = OLMS_EXCHANGE_VERSION;
+        exchangeArgs.count = count;
+        std::copy(masks, masks+count, exchangeArgs.prefer_bits);
+        if (weights!=NULL) {
+            std::copy(weights, weights+OLMS_SHM_MAX_SUBFLOWS, exchangeArgs.weights);
+        }
+        else {
+            std::fill(exchangeArgs.weights, exchangeArgs.weights+OLMS_SHM_MAX_SUBFLOWS, 0);
+        }
+        int ret = exchanger ? exchanger(exchangeArgs) : ioctl(device(), OLMS_IOC_EXCHANGE, &exchangeArgs);
         if (ret<0) {
-            std::cerr << "ioctl PREFER failed" << std::endl;
+            std::cerr << "ioctl EXCHANGE failed" << std::endl;
             return ret;
         }
-        return args.len;
+        lastGeneration = exchangeArgs.generation;
+        return 0;
+    }
+
+    int setPreferredPaths(const std::vector<uint>& is, uint K)
+    {
+        const uint64_t mask = kernelMask(is, K);
+        int ret = exchange(&mask, 1);
+        return ret<0 ? ret : is.size();
+    }
+
+    // Splits the data over the K paths in proportion to the fractional
+    // selection vt of a policy, the selected paths is are the fallback.
+    int setPathWeights(const std::vector<uint>& is, const std::vector<double>& vt, uint K)
+    {
+        uint32_t weights[OLMS_SHM_MAX_SUBFLOWS] = {0};
+        for (uint i = 0; i<K && (K+1)*i<OLMS_SHM_MAX_SUBFLOWS; ++i) {
+            weights[(K+1)*i] = (uint32_t) std::lround(std::max(0.0, std::min(vt[i], 1.0))*OLMS_WEIGHT_SCALE);
+        }
+        const uint64_t mask = kernelMask(is, K);
+        int ret = exchange(&mask, 1, weights);
+        return ret<0 ? ret : is.size();
+    }
+
+    // the preferred paths of the next rounds, one round per publication
+    int setPreferredPathsBatch(const std::vector<std::vector<uint>>& rounds, uint K)
+    {
+        uint64_t masks[OLMS_EXCHANGE_MAX_BATCH];
+        if (rounds.empty() || rounds.size()>OLMS_EXCHANGE_MAX_BATCH) {
+            std::cerr << "setPreferredPathsBatch: " << rounds.size() << " rounds, 1 to "
+                      << OLMS_EXCHANGE_MAX_BATCH << std::endl;
+            return -EINVAL;
+        }
+        for (uint r = 0; r<rounds.size(); ++r) {
+            masks[r] = kernelMask(rounds[r], K);
+        }
+        return exchange(masks, rounds.size());
     }
+
+private:
+    // a consistent copy of the page
+    struct olms_shm_page snapshot;
+    struct olms_exchange exchangeArgs;
+    uint numValid;
+    std::vector<uint> rawRtt;
+    std::vector<uint> rawBw;
+    // the page entry of every path with a sample
+    std::vector<uint> pathIndex;
+    // the counters of the last fetch, by page entry
+    std::vector<uint> prevLost;
+    std::vector<uint> prevDelivered;
 } kolms;
 } // namespace bandit
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "macro_util.h"
+#include "bandit_util.hpp"
+
+namespace bandit {
+
+// Set of path ids below N in the bits of a uint64_t, so it is copied and
+// compared as one word. The ids are visited in ascending order.
+template<uint N = MAX_NUM_PATHS>
+class PathSet {
+    static_assert(N<=64, "a PathSet holds at most 64 paths");
+
+    uint64_t bits;
+
+public:
+    class iterator {
+        // the ids not visited yet
+        uint64_t rest;
+
+    public:
+        explicit iterator(uint64_t rest)
+                :rest(rest)
+        {
+        }
+
+        uint operator*() const
+        {
+            return __builtin_ctzll(rest);
+        }
+
+        iterator& operator++()
+        {
+            rest &= rest-1;
+            return *this;
+        }
+
+        bool operator!=(const iterator& other) const
+        {
+            return rest!=other.rest;
+        }
+    };
+
+    PathSet()
+            :bits(0)
+    {
+    }
+
+    explicit PathSet(uint64_t bits)
+            :bits(bits)
+    {
+    }
+
+    explicit PathSet(const std::vector<uint>& ids)
+            :bits(0)
+    {
+        for (const auto& i : ids) {
+            insert(i);
+        }
+    }
+
+    void insert(uint i)
+    {
+        bits |= uint64_t(1) << i;
+    }
+
+    void erase(uint i)
+    {
+        bits &= ~(uint64_t(1) << i);
+    }
+
+    bool contains(uint i) const
+    {
+        return (bits >> i) & 1;
+    }
+
+    uint size() const
+    {
+        return __builtin_popcountll(bits);
+    }
+
+    bool empty() const
+    {
+        return bits==0;
+    }
+
+    void clear()
+    {
+        bits = 0;
+    }
+
+    uint64_t mask() const
+    {
+        return bits;
+    }
+
+    iterator begin() const
+    {
+        return iterator(bits);
+    }
+
+    iterator end() const
+    {
+        return iterator(0);
+    }
+
+    bool operator==(const PathSet& other) const
+    {
+        return bits==other.bits;
+    }
+
+    bool operator!=(const PathSet& other) const
+    {
+        return bits!=other.bits;
+    }
+};
+
+// The measurements of a round in a fixed array indexed by path id. Only
+// the entries of the selected paths are meaningful to a policy.
+template<uint N = MAX_NUM_PATHS>
+struct MetricBlock {
+    Metric metrics[N];
+
+    Metric& operator[](uint i)
+    {
+        return metrics[i];
+    }
+
+    const Metric& operator[](uint i) const
+    {
+        return metrics[i];
+    }
+};
+
+} //namespace
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "macro_util.h"
+#include "bandit_util.hpp"
+
+namespace bandit {
+
+enum PosteriorMode {
+    POSTERIOR_STATIONARY,
+    POSTERIOR_DISCOUNTED,
+    POSTERIOR_WINDOW
+};
+
+// a discount of 0 or below divides by zero or flips the weights, above 1
+// the old outcomes would outweigh the new ones
+inline double checkDiscount(double discount)
+{
+    if (!(discount>0 && discount<=1)) {
+        std::cerr << "Invalid posterior discount: " << discount << " (0 < discount <= 1, i.e. 0 <= damping < 1)"
+                  << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return discount;
+}
+
+// how the posteriors of a policy forget, see BetaPosterior
+struct PosteriorParams {
+    PosteriorMode mode;
+    // discounted: an outcome of age a rounds weighs discount^a
+    double discount;
+    // window: only the outcomes of the last window rounds count
+    uint window;
+
+    explicit PosteriorParams(PosteriorMode mode = POSTERIOR_STATIONARY, double discount = 0.99,
+            uint window = 1000)
+            :mode(mode), discount(checkDiscount(discount)), window(window)
+    {
+    }
+};
+
+inline PosteriorMode posteriorModeFromString(const std::string& name)
+{
+    if (name=="stationary") {
+        return POSTERIOR_STATIONARY;
+    }
+    if (name=="discounted") {
+        return POSTERIOR_DISCOUNTED;
+    }
+    if (name=="window") {
+        return POSTERIOR_WINDOW;
+    }
+    std::cerr << "Unknown posterior: " << name << " (stationary | discounted | window)" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+// the discounted counts are rescaled when the weight of a new outcome passes this
+const double POSTERIOR_MAX_WEIGHT = 1e100;
+
+// Beta posteriors of K Bernoulli arms with the prior Beta(s, f). A round
+// starts with nextRound(), then observe() adds the outcomes of the played
+// arms; both are O(1).
+//
+// - stationary: alpha = s + successes, beta = f + failures.
+// - discounted: an outcome of age a rounds weighs discount^a. A count is
+//   kept in the units of round 0, i.e. an outcome of round t adds
+//   discount^-t, so a round only changes that weight and not the counts
+//   of the K arms. The counts are rescaled when the weight gets large.
+// - window: the outcomes of the last window rounds, in a ring buffer; an
+//   outcome is subtracted again when its round leaves the window.
+class BetaPosterior {
+public:
+    explicit BetaPosterior(uint K = 0, double s = 1, double f = 1, const PosteriorParams& params = PosteriorParams())
+            :K(K), s0(s), f0(f), params(params), successes(K, 0), failures(K, 0), weight(1),
+             ring(params.mode==POSTERIOR_WINDOW ? std::max(1u, params.window*K) : 0),
+             oldest(0), stored(0), round(0), alpha(K, s), beta(K, f), dirty(false)
+    {
+    }
+
+    void nextRound()
+    {
+        ++round;
+        if (params.mode==POSTERIOR_DISCOUNTED) {
+            weight /= params.discount;
+            if (weight>POSTERIOR_MAX_WEIGHT) {
+                for (uint k = 0; k<K; ++k) {
+                    successes[k] /= weight;
+                    failures[k] /= weight;
+                }
+                weight = 1;
+            }
+            dirty = true;
+        }
+        else if (params.mode==POSTERIOR_WINDOW) {
+            while (stored>0 && ring[oldest].round+params.window<=round) {
+                dropOldest();
+            }
+        }
+    }
+
+    void observe(uint k, bool success)
+    {
+        if (params.mode==POSTERIOR_WINDOW) {
+            // at most one outcome per arm and round fits, drop the oldest otherwise
+            if (stored==ring.size()) {
+                dropOldest();
+            }
+            Outcome& o = ring[(oldest+stored)%ring.size()];
+            o.round = round;
+            o.arm = k;
+            o.success = success;
+            ++stored;
+        }
+        (success ? successes : failures)[k] += weight;
+        dirty = true;
+    }
+
+    // the parameters of all arms, valid until the next update
+    const std::vector<double>& alphas()
+    {
+        refresh();
+        return alpha;
+    }
+
+    const std::vector<double>& betas()
+    {
+        refresh();
+        return beta;
+    }
+
+private:
+    struct Outcome {
+        uint32_t round;
+        uint16_t arm;
+        bool success;
+    };
+
+    uint K;
+    double s0, f0;
+    PosteriorParams params;
+    // in the units of round 0 when discounted
+    std::vector<double> successes, failures;
+    // the weight of an outcome of this round
+    double weight;
+    std::vector<Outcome> ring;
+    size_t oldest, stored;
+    uint32_t round;
+    std::vector<double> alpha, beta;
+    bool dirty;
+
+    void dropOldest()
+    {
+        const Outcome& o = ring[oldest];
+        (o.success ? successes : failures)[o.arm] -= 1;
+        oldest = (oldest+1)%ring.size();
+        --stored;
+        dirty = true;
+    }
+
+    void refresh()
+    {
+        if (!dirty) {
+            return;
+        }
+        const double scale = 1/weight;
+        for (uint k = 0; k<K; ++k) {
+            alpha[k] = s0+successes[k]*scale;
+            beta[k] = f0+failures[k]*scale;
+        }
+        dirty = false;
+    }
+};
+
+} //namespace
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace bandit {
+
+// Philox4x32-10 counter-based generator, from Salmon et al., "Parallel
+// random numbers: as easy as 1, 2, 3" (SC 2011). A block of four 32-bit
+// words is a bijection of a 128-bit counter under a 64-bit key, so any
+// block of any stream can be computed directly without generator state.
+struct Philox4x32 {
+    static const int ROUNDS = 10;
+
+    static void bijection(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4])
+    {
+        uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+        uint32_t k0 = key[0], k1 = key[1];
+        for (int r = 0; r<ROUNDS; ++r) {
+            const uint64_t p0 = uint64_t(0xD2511F53u)*c0;
+            const uint64_t p1 = uint64_t(0xCD9E8D57u)*c2;
+            const uint32_t n0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+            const uint32_t n2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+            c1 = uint32_t(p1);
+            c3 = uint32_t(p0);
+            c0 = n0;
+            c2 = n2;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        out[0] = c0;
+        out[1] = c1;
+        out[2] = c2;
+        out[3] = c3;
+    }
+
+    // LANES blocks at the counters (ctr[0]+j, ctr[1], ctr[2], ctr[3]), word w
+    // of block j in out[w][j]; the lanes are independent, so the loops
+    // vectorize
+    static const int LANES = 8;
+
+    static void bijectionLanes(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4][LANES])
+    {
+        uint32_t c0[LANES], c1[LANES], c2[LANES], c3[LANES];
+        for (int j = 0; j<LANES; ++j) {
+            c0[j] = ctr[0]+j;
+            c1[j] = ctr[1];
+            c2[j] = ctr[2];
+            c3[j] = ctr[3];
+        }
+        uint32_t k0 = key[0], k1 = key[1];
+        for (int r = 0; r<ROUNDS; ++r) {
+            for (int j = 0; j<LANES; ++j) {
+                const uint64_t p0 = uint64_t(0xD2511F53u)*c0[j];
+                const uint64_t p1 = uint64_t(0xCD9E8D57u)*c2[j];
+                const uint32_t n0 = uint32_t(p1 >> 32) ^ c1[j] ^ k0;
+                const uint32_t n2 = uint32_t(p0 >> 32) ^ c3[j] ^ k1;
+                c1[j] = uint32_t(p1);
+                c3[j] = uint32_t(p0);
+                c0[j] = n0;
+                c2[j] = n2;
+            }
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        for (int j = 0; j<LANES; ++j) {
+            out[0][j] = c0[j];
+            out[1][j] = c1[j];
+            out[2][j] = c2[j];
+            out[3][j] = c3[j];
+        }
+    }
+};
+
+// streams of a round that are not a path
+const uint32_t RNG_STREAM_SELECT = 0xFFFFFFFEu;
+const uint32_t RNG_STREAM_UPDATE = 0xFFFFFFFFu;
+
+// Uniform random bit generator over Philox4x32 streams. The key is
+// (seed, run); the counter is (draw, round, policy, stream), where the
+// stream is a path id or one of RNG_STREAM_*. The numbers drawn after
+// setStream() only depend on (seed, run, round, policy, stream), not on
+// what was drawn before, so a run does not depend on the call order of
+// the policies or the threads.
+class PhiloxEngine {
+public:
+    typedef uint32_t result_type;
+
+    static constexpr result_type min() { return 0; }
+
+    static constexpr result_type max() { return 0xFFFFFFFFu; }
+
+    explicit PhiloxEngine(uint64_t seed = 0, uint32_t run = 0)
+    {
+        setKey(seed, run);
+    }
+
+    void seed(uint64_t seed)
+    {
+        setKey(seed, 0);
+    }
+
+    void setKey(uint64_t seed, uint32_t run)
+    {
+        // a 32-bit seed and the run fill the 64-bit key
+        key[0] = uint32_t(seed) ^ uint32_t(seed >> 32);
+        key[1] = run;
+        setStream(0, 0, 0);
+    }
+
+    // start the stream of (round, policy, stream) from its first draw
+    void setStream(uint32_t round, uint32_t policy, uint32_t stream)
+    {
+        ctr[0] = 0;
+        ctr[1] = round;
+        ctr[2] = policy;
+        ctr[3] = stream;
+        used = 4;
+    }
+
+    result_type operator()()
+    {
+        if (used==4) {
+            nextBlock(block);
+            used = 0;
+        }
+        return block[used++];
+    }
+
+    void discard(unsigned long long n)
+    {
+        for (; n>0; --n) {
+            (*this)();
+        }
+    }
+
+    // n uniforms in [0, 1) with 53 random bits, two per block. The words
+    // of a partly used block are dropped.
+    void fillUniform(double* out, size_t n)
+    {
+        const double scale = 1.0/9007199254740992.0; // 2^-53
+        uint32_t w[4];
+        size_t k = 0;
+        // whole groups of lanes first, the same blocks as one at a time
+        uint32_t lanes[4][Philox4x32::LANES];
+        for (; k+2*Philox4x32::LANES<=n; k += 2*Philox4x32::LANES) {
+            Philox4x32::bijectionLanes(ctr, key, lanes);
+            ctr[0] += Philox4x32::LANES;
+            for (int j = 0; j<Philox4x32::LANES; ++j) {
+                out[k+2*j] = ((lanes[0][j] >> 5)*67108864.0+(lanes[1][j] >> 6))*scale;
+                out[k+2*j+1] = ((lanes[2][j] >> 5)*67108864.0+(lanes[3][j] >> 6))*scale;
+            }
+        }
+        for (; k+2<=n; k += 2) {
+            nextBlock(w);
+            out[k] = ((w[0] >> 5)*67108864.0+(w[1] >> 6))*scale;
+            out[k+1] = ((w[2] >> 5)*67108864.0+(w[3] >> 6))*scale;
+        }
+        if (k<n) {
+            nextBlock(w);
+            out[k] = ((w[0] >> 5)*67108864.0+(w[1] >> 6))*scale;
+        }
+        used = 4;
+    }
+
+    void fillUniform(std::vector<double>& out)
+    {
+        fillUniform(out.data(), out.size());
+    }
+
+private:
+    uint32_t key[2];
+    uint32_t ctr[4];
+    uint32_t block[4];
+    int used;
+
+    void nextBlock(uint32_t out[4])
+    {
+        Philox4x32::bijection(ctr, key, out);
+        ++ctr[0];
+    }
+};
+
+} //namespace
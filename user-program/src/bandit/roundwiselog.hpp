@@ -5,23 +5,120 @@
 #include "../path/path.hpp"
 #include "../policy/policy.hpp"
 
+#include <cstdio>
+
 #define NUM_PRECISION 4
 
 namespace bandit {
 
+// digits after the point in the log files, as std::ios::fixed prints them
+const int LOG_DECIMALS = 6;
+// bytes formatted before a write to the log file
+const size_t LOG_WRITE_CHUNK = 1 << 16;
+
+// Writes v like printf("%.6f") to out and returns the end, without the
+// locale and stream state handling of iostream.
+inline char* formatFixed(char* out, double v)
+{
+    if (!(std::fabs(v)<1e12)) { // nan, inf or too large for the fast path
+        return out+std::sprintf(out, "%.*f", LOG_DECIMALS, v);
+    }
+    if (std::signbit(v)) {
+        *out++ = '-';
+        v = -v;
+    }
+    const unsigned long long scaled = (unsigned long long) std::llround(v*1e6);
+    unsigned long long ip = scaled/1000000;
+    unsigned long long fp = scaled%1000000;
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = char('0'+ip%10);
+        ip /= 10;
+    } while (ip>0);
+    while (n>0) {
+        *out++ = digits[--n];
+    }
+    *out++ = '.';
+    for (int i = LOG_DECIMALS-1; i>=0; --i) {
+        out[i] = char('0'+fp%10);
+        fp /= 10;
+    }
+    return out+LOG_DECIMALS;
+}
+
+// text of a log file, written to the stream in chunks
+class LogLineBuffer {
+    std::ofstream& ofs;
+    std::string buf;
+
+public:
+    explicit LogLineBuffer(std::ofstream& ofs)
+            :ofs(ofs)
+    {
+        buf.reserve(2*LOG_WRITE_CHUNK);
+    }
+
+    ~LogLineBuffer()
+    {
+        flush();
+    }
+
+    // " v"
+    void value(double v)
+    {
+        char tmp[32];
+        tmp[0] = ' ';
+        buf.append(tmp, formatFixed(tmp+1, v)-tmp);
+    }
+
+    void round(uint t)
+    {
+        char tmp[16];
+        buf.append(tmp, std::sprintf(tmp, "%u", t));
+    }
+
+    void endLine()
+    {
+        buf.push_back('\n');
+        if (buf.size()>=LOG_WRITE_CHUNK) {
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        ofs.write(buf.data(), buf.size());
+        buf.clear();
+    }
+};
+
+// out[k] = sum[k]*scale over the whole buffer
+inline void scaleInto(std::vector<double>& out, const std::vector<double>& sum, double scale)
+{
+    out.resize(sum.size());
+    double* __restrict__ o = out.data();
+    const double* __restrict__ s = sum.data();
+    for (size_t k = 0; k<sum.size(); ++k) {
+        o[k] = s[k]*scale;
+    }
+}
+
 class RoundwiseLog {
 public:
 
     uint P, T, simulationTimes;
 
+    // all buffers are P x T, policy p at round t is at p*T+t
+
     // roundwise reward is the total bandwidth at time t
-    vec2Double roundwiseRewards;
+    std::vector<double> roundwiseRewards;
 
     // roundwise violation is the sum(r - h) at time t
-    vec2Double roundwiseViolations;
+    std::vector<double> roundwiseViolations;
 
     // roundwise regret is the loss compared to the Oracle
-    vec2Double roundwiseRegrets;
+    std::vector<double> roundwiseRegrets;
 
     // roundwise measurement is the measurement at time t
     // vec2Metric roundwiseMeasurements;
@@ -34,14 +131,18 @@ public:
     RoundwiseLog(uint P, uint T)
             :P(P), T(T)
     {
-        roundwiseRewards = vec2Double(P, std::vector<double>(T, 0.0));
-        roundwiseRegrets = vec2Double(P, std::vector<double>(T, 0.0));
-        roundwiseViolations = vec2Double(P, std::vector<double>(T, 0.0));
-        // roundwiseMeasurements = vec2Metric(P, std::vector<Metric>(T, {0.0, 0.0, 0.0}));
+        roundwiseRewards.assign((size_t) P*T, 0.0);
+        roundwiseRegrets.assign((size_t) P*T, 0.0);
+        roundwiseViolations.assign((size_t) P*T, 0.0);
         simulationTimes = 0; // times of simulation
         oracleRwReward = 0.0;
     }
 
+    size_t index(uint p, uint t) const
+    {
+        return (size_t) p*T+t;
+    }
+
     //start new simulation
     void addSimulation()
     {
@@ -52,9 +153,10 @@ public:
     // incurred the regretDelta and the violation
     void record(uint p, uint t, double rewardAtT, double regretDeltaAtT, double violationAtT)
     {
-        roundwiseRewards[p][t] += rewardAtT;
-        roundwiseRegrets[p][t] += regretDeltaAtT;
-        roundwiseViolations[p][t] += violationAtT; // sum (r-h), this can be negative
+        const size_t k = index(p, t);
+        roundwiseRewards[k] += rewardAtT;
+        roundwiseRegrets[k] += regretDeltaAtT;
+        roundwiseViolations[k] += violationAtT; // sum (r-h), this can be negative
     }
 };
 
@@ -79,7 +181,6 @@ public:
             std::cout << "#policy " << p << " " << policyNames[p] << std::endl;
         }
 #endif
-        ofs.setf(std::ios::fixed, std::ios::floatfield);
 
         // write the header
         ofs << "#results:" << std::endl;
@@ -110,24 +211,32 @@ public:
         std::cout << std::endl;
 #endif
 
+        // average over the simulations in one pass per buffer
+        const double scale = 1.0/log.simulationTimes;
+        std::vector<double> rewards, regrets, violations;
+        scaleInto(rewards, log.roundwiseRewards, scale);
+        scaleInto(regrets, log.roundwiseRegrets, scale);
+        scaleInto(violations, log.roundwiseViolations, scale);
+
         // write the reward, regret, and violation of each policy
         std::vector<double> cumReward(P, 0.0);
         std::vector<double> cumRegret(P, 0.0);
         std::vector<double> cumViolation(P, 0.0);
 
-        std::cout.precision(NUM_PRECISION);
+        LogLineBuffer out(ofs);
         for (uint t = 0; t<T; ++t) {
-            ofs << (t+1);
+            out.round(t+1);
             for (uint p = 0; p<P; ++p) {
-                cumReward[p] += log.roundwiseRewards[p][t];
-                cumRegret[p] += log.roundwiseRegrets[p][t];
-                cumViolation[p] += log.roundwiseViolations[p][t];
-                ofs << " " << (t*log.oracleRwReward)/log.simulationTimes; // oracle
-                ofs << " " << cumReward[p]/log.simulationTimes; // reward
-                ofs << " " << cumRegret[p]/log.simulationTimes; // regret
-                ofs << " " << max(cumViolation[p]/log.simulationTimes, 0.0); //violation
+                const size_t k = log.index(p, t);
+                cumReward[p] += rewards[k];
+                cumRegret[p] += regrets[k];
+                cumViolation[p] += violations[k];
+                out.value((t*log.oracleRwReward)*scale); // oracle
+                out.value(cumReward[p]); // reward
+                out.value(cumRegret[p]); // regret
+                out.value(max(cumViolation[p], 0.0)); //violation
             }
-            ofs << std::endl;
+            out.endLine();
         }
     }
 };
@@ -138,22 +247,31 @@ public:
     uint P, T, K, simulationTimes;
     bool forever;
 
-    // vector<vector<vector<string>>> vec1(DIM1, vector<vector<string>>(DIM2, vector<string>(DIM3)));
-    vec3Metric policyTimeKMetric;
-    vec3Uint policyTimeKpaths;
+    // one buffer per metric, P x T x K: path i of policy p at round t
+    // is at (p*T+t)*K+i
+    std::vector<double> rtt;
+    std::vector<double> bw;
+    std::vector<double> lossrate;
+    // times path i was selected
+    std::vector<uint> selected;
 
     RoundwiseFullLog(uint P, uint T, uint K, bool isForever_)
-            :P(P), T(T), K(K), forever(isForever_)
+            :P(P), T(T), K(K), simulationTimes(0), forever(isForever_)
     {
         if (!forever) {
-            policyTimeKMetric = vec3Metric(P,
-                    std::vector<std::vector<Metric> >(T, std::vector<Metric>(K, {0.0, 0.0, 0.0})));
-            policyTimeKpaths = vec3Uint(P,
-                    std::vector<std::vector<uint> >(T, std::vector<uint>(K, 0)));
-            simulationTimes = 0; // times of simulation
+            const size_t n = (size_t) P*T*K;
+            rtt.assign(n, 0.0);
+            bw.assign(n, 0.0);
+            lossrate.assign(n, 0.0);
+            selected.assign(n, 0);
         }
     }
 
+    size_t index(uint p, uint t, uint i) const
+    {
+        return ((size_t) p*T+t)*K+i;
+    }
+
     //start new simulation
     void addSimulation()
     {
@@ -167,14 +285,48 @@ public:
     void recordMeasurements(uint p, uint t, uint i, Metric m)
     {
         if (!forever) {
-            policyTimeKMetric[p][t][i] += m;
+            const size_t k = index(p, t, i);
+            rtt[k] += m.r;
+            bw[k] += m.b;
+            lossrate[k] += m.l;
         }
     }
 
     void recordSelectedPaths(uint p, uint t, uint i)
     {
         if (!forever) {
-            policyTimeKpaths[p][t][i] += 1;
+            selected[index(p, t, i)] += 1;
+        }
+    }
+
+    // policy p finished round t, everything is already recorded
+    void endRound(uint p, uint t)
+    {
+    }
+
+    void close()
+    {
+    }
+
+    // forget all simulations, keeping the buffers
+    void clear()
+    {
+        simulationTimes = 0;
+        std::fill(rtt.begin(), rtt.end(), 0.0);
+        std::fill(bw.begin(), bw.end(), 0.0);
+        std::fill(lossrate.begin(), lossrate.end(), 0.0);
+        std::fill(selected.begin(), selected.end(), 0);
+    }
+
+    // add the simulations of a log of the same shape
+    void merge(const RoundwiseFullLog& o)
+    {
+        simulationTimes += o.simulationTimes;
+        for (size_t k = 0; k<rtt.size(); ++k) {
+            rtt[k] += o.rtt[k];
+            bw[k] += o.bw[k];
+            lossrate[k] += o.lossrate[k];
+            selected[k] += o.selected[k];
         }
     }
 };
@@ -186,13 +338,13 @@ public:
     {
         if (!fulllog.forever) {
             const uint P = policyNames.size();
+            const uint K = fulllog.K;
             std::ofstream ofs(outputFile);
             ofs << "# result in: " << fulllog.simulationTimes
                 << " simulations." << std::endl;
             for (uint p = 0; p<P; ++p) {
                 ofs << "# policy " << p << " " << policyNames[p] << std::endl;
             }
-            ofs.setf(std::ios::fixed, std::ios::floatfield);
 
             // write the header
             ofs << "#results:" << std::endl;
@@ -211,43 +363,56 @@ public:
             }
             ofs << std::endl;
 
+            // average over the simulations in one pass per buffer
+            const double scale = 1.0/fulllog.simulationTimes;
+            std::vector<double> selection(fulllog.selected.size());
+            for (size_t k = 0; k<selection.size(); ++k) {
+                selection[k] = fulllog.selected[k]*scale;
+            }
+            std::vector<double> rtt, bw, lossrate;
+            scaleInto(rtt, fulllog.rtt, scale);
+            scaleInto(bw, fulllog.bw, scale);
+            scaleInto(lossrate, fulllog.lossrate, scale);
+
             // write the selection, rtt, bw and lossrate of each policy
             std::cout.precision(NUM_PRECISION);
+            LogLineBuffer out(ofs);
             for (uint t = 0; t<T; ++t) {
-                ofs << (t+1);
+                out.round(t+1);
                 for (uint p = 0; p<P; ++p) {
+                    const size_t k0 = fulllog.index(p, t, 0);
 #if DEBUG_mode
                     // print the selected times
                     std::cout << "#t: " << t;
-                    for (const auto& i : fulllog.policyTimeKpaths[p][t]) {
-                        std::cout << " " << (i*1.0)/fulllog.simulationTimes;
+                    for (uint i = 0; i<K; ++i) {
+                        std::cout << " " << selection[k0+i];
                     }
                     std::cout << std::endl;
                     // print the rtt measurement
                     std::cout << "#t: " << t;
-                    for (const auto& m : fulllog.policyTimeKMetric[p][t]) {
-                        std::cout << " " << (m.r)/fulllog.simulationTimes;
+                    for (uint i = 0; i<K; ++i) {
+                        std::cout << " " << rtt[k0+i];
                     }
                     std::cout << std::endl;
 #endif
                     // log the selection vector
-                    for (const auto& i : fulllog.policyTimeKpaths[p][t]) {
-                        ofs << " " << (i*1.0)/fulllog.simulationTimes;
+                    for (uint i = 0; i<K; ++i) {
+                        out.value(selection[k0+i]);
                     }
                     // log the rtt measurements
-                    for (const auto& m : fulllog.policyTimeKMetric[p][t]) {
-                        ofs << " " << (m.r)/fulllog.simulationTimes;
+                    for (uint i = 0; i<K; ++i) {
+                        out.value(rtt[k0+i]);
                     }
                     // log the bw measurements
-                    for (const auto& m : fulllog.policyTimeKMetric[p][t]) {
-                        ofs << " " << (m.b)/fulllog.simulationTimes;
+                    for (uint i = 0; i<K; ++i) {
+                        out.value(bw[k0+i]);
                     }
                     // log the loss rate measurements
-                    for (const auto& m : fulllog.policyTimeKMetric[p][t]) {
-                        ofs << " " << (m.l)/fulllog.simulationTimes;
+                    for (uint i = 0; i<K; ++i) {
+                        out.value(lossrate[k0+i]);
                     }
                 }
-                ofs << std::endl;
+                out.endLine();
             }
         }
     }
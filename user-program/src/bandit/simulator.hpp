@@ -8,6 +8,7 @@
 #include "../policy/policy_conmpts_bandwidth.hpp"
 #include "../policy/policy_conmpts_loss.hpp"
 #include "../bandit/roundwiselog.hpp"
+#include "../bandit/async_log.hpp"
 
 #include <thread>
 #include <chrono>
@@ -15,13 +16,48 @@
 namespace bandit {
 
 typedef std::shared_ptr<Path> PathPtr;
-typedef std::shared_ptr<Policy> PolicyPtr;
 
-template<class Log = RoundwiseLog>
+// The time a policy spends deciding: selectNextPaths and updateState of a
+// round, without the measurements and the logging in between.
+struct DecisionTime {
+    uint64_t rounds;
+    double totalNs;
+    double maxNs;
+
+    DecisionTime()
+            :rounds(0), totalNs(0), maxNs(0)
+    {
+    }
+
+    void add(double ns)
+    {
+        ++rounds;
+        totalNs += ns;
+        maxNs = std::max(maxNs, ns);
+    }
+
+    void merge(const DecisionTime& other)
+    {
+        rounds += other.rounds;
+        totalNs += other.totalNs;
+        maxNs = std::max(maxNs, other.maxNs);
+    }
+
+    double meanUs() const
+    {
+        return rounds==0 ? 0 : totalNs/rounds/1000;
+    }
+};
+
+// Runs the policies on the paths round by round. With PolicyT = Policy
+// and PathT = Path the calls are virtual, for comparing several policies;
+// with a final policy and path class they are bound at compile time and
+// can be inlined into the round.
+template<class PolicyT = Policy, class PathT = Path, class Log = RoundwiseLog>
 class Simulator {
     // bool recommendBest; // using the best path or M paths
-    std::vector<PathPtr> paths;
-    std::vector<PolicyPtr> policies;
+    std::vector<std::shared_ptr<PathT>> paths;
+    std::vector<std::shared_ptr<PolicyT>> policies;
 
     const uint M; //selects M out of K paths in each round
     const uint K;
@@ -29,20 +65,44 @@ class Simulator {
 
     // get the max reward per round of the oracle.
     double oracleRewardAtT;
-    // the interval for sleep
+    // the longest wait for new kernel samples (us)
     uint delta_t;
-    std::vector<uint> all_paths;
+    // the rounds wait for and talk to the kernel
+    bool kernelPaths;
+
+    // per-round buffers, reused so that a round in steady state does not allocate
+    std::vector<uint> is;
+    // the paths in is
+    PathSet<> selected;
+    // measurements indexed by path id
+    MetricBlock<> measurements;
+    std::vector<double> rewards;
+    std::vector<double> violations;
+    // per policy
+    std::vector<DecisionTime> decisionTimes;
 
 public:
-    Simulator(const std::vector<PathPtr>& paths, const std::vector<PolicyPtr>& policies, uint M, double threshold,
-            uint Delta_t)
-            :paths(paths), policies(policies), M(M), K(paths.size()), threshold(threshold), delta_t(Delta_t)
+    Simulator(const std::vector<std::shared_ptr<PathT>>& paths, const std::vector<std::shared_ptr<PolicyT>>& policies,
+            uint M, double threshold, uint Delta_t)
+            :paths(paths), policies(policies), M(M), K(paths.size()), threshold(threshold), delta_t(Delta_t),
+             kernelPaths(false)
     // recommendBest(theBestpath)
     {
         if (M>K) {
             std::cerr << "Simulator: M > K！ Abort!" << std::endl;
             abort();
         }
+        if (K>MAX_NUM_PATHS) {
+            std::cerr << "Simulator: more than " << MAX_NUM_PATHS << " paths! Abort!" << std::endl;
+            abort();
+        }
+        for (const auto& path : paths) {
+            kernelPaths = kernelPaths || path->getType()==PathType::KERNEL;
+        }
+        is.reserve(K);
+        decisionTimes.resize(policies.size());
+        rewards.reserve(K);
+        violations.reserve(K);
         std::vector<double> r;
         std::vector<double> b;
         std::vector<double> l;
@@ -51,36 +111,16 @@ public:
             r.push_back(mean.r);
             b.push_back(mean.b);
         }
-        for (int i = 0; i<paths.size(); ++i) {
-            all_paths.push_back(i);
-        }
         if (0) {
-            // Compute the oracle of the ConMPTSLatency policy
+            // Compute the oracle of the constrained policies
             printMsg("Computing oracle...");
             for (auto& policy: policies) {
-                if (policy->getType()==PolicyType::CONMPTS_Latency) {
-                    std::shared_ptr<ConMPTSLatency> pConMPTS = std::static_pointer_cast<ConMPTSLatency>(policy);
-                    printVec("r", r);
-                    printVec("b", b);
-                    printVar("M", M);
-                    printVar("threshold", threshold);
-                    oracleRewardAtT = pConMPTS->computeOracleLatency(r, b, M, threshold);
-                }
-                if (policy->getType()==PolicyType::CONMPTS_Bandwidth) {
-                    std::shared_ptr<ConMPTSBandwidth> pConMPTS = std::static_pointer_cast<ConMPTSBandwidth>(policy);
-                    printVec("r", r);
-                    printVec("b", b);
-                    printVar("M", M);
-                    printVar("threshold", threshold);
-                    oracleRewardAtT = pConMPTS->computeOracleBandwidth(r, b, M, threshold);
-                }
-                if (policy->getType()==PolicyType::CONMPTS_Loss) {
-                    std::shared_ptr<ConMPTSLoss> pConMPTS = std::static_pointer_cast<ConMPTSLoss>(policy);
+                if (policy->hasOracle()) {
                     printVec("r", r);
                     printVec("b", b);
                     printVar("M", M);
                     printVar("threshold", threshold);
-                    oracleRewardAtT = pConMPTS->computeOracleLoss(r, b, M, threshold);
+                    oracleRewardAtT = policy->computeOracle(r, b, M, threshold);
                 }
             }
         }
@@ -91,6 +131,9 @@ public:
         log.addSimulation();
         // log.oracleRwReward = oracleRewardAtT;
         for (uint t = 0; t<T; ++t) {
+            for (const auto& path : paths) {
+                path->beginRound(t);
+            }
             for (uint p = 0; p<policies.size(); ++p) {
                 //execSingleRoundDamped(log, p, t);
                 execSingleRound(log, p, t);
@@ -98,124 +141,119 @@ public:
         }
     }
 
+    const std::vector<DecisionTime>& getDecisionTimes() const
+    {
+        return decisionTimes;
+    }
+
     void execSingleRound(Log& log, uint p, uint t)
     {
-        std::vector<uint> is;
-        is = policies[p]->selectNextPaths(M);
+        typedef std::chrono::steady_clock Clock;
+        randomEngine.setStream(t, p, RNG_STREAM_SELECT);
+        Clock::time_point selectStart = Clock::now();
+        policies[p]->selectNextPaths(M, is);
+        Clock::duration selectTime = Clock::now()-selectStart;
+        selected = PathSet<>(is);
 
 #ifdef OLMS_KERNEL
-        kolms.setPreferredPaths(is, K);
-#endif
+        if (kernelPaths) {
+            const std::vector<double>* vt = kolms.split ? policies[p]->selectionWeights() : NULL;
+            if (vt!=NULL) {
+                kolms.setPathWeights(is, *vt, K);
+            }
+            else {
+                kolms.setPreferredPaths(is, K);
+            }
 
-#ifdef OLMS_KERNEL
-        // the clock is used here.
-        // wait for the measurements
-        // std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        std::this_thread::sleep_for(std::chrono::microseconds(delta_t));
-        int kernel_status = kolms.fetchMeasurements();
-        //if (kernel_status==-1) {
-        if (kernel_status<0 && log.forever) {
-            // if (kernel_status<0) {
-            std::cout << "status: " << kernel_status << std::endl;
-            std::cout << "No measurement. Transmission ended." << std::endl;
-            exit(0);
+            // a round per publication of new samples, or after delta_t
+            // without one
+            kolms.waitForSample(delta_t);
+            int kernel_status = kolms.fetchMeasurements();
+            //if (kernel_status==-1) {
+            if (kernel_status<0 && log.forever) {
+                // if (kernel_status<0) {
+                log.close();
+                olmsLog.stop();
+                kolms.stopRecording();
+                std::cout << "status: " << kernel_status << std::endl;
+                std::cout << "No measurement. Transmission ended." << std::endl;
+                exit(0);
+            }
         }
 #endif
 
-        std::vector<Metric> measurements;
-        // std::vector<double> rewards;
-        // std::vector<double> violations;
-        Metric measurementAtT;
-
-        for (const auto& i : all_paths) {
-            measurementAtT = paths[i]->getMeasurement();
-
-            if (std::find(is.begin(), is.end(), i)!=is.end()) {
-                measurements.push_back(measurementAtT);
+        for (uint i = 0; i<K; ++i) {
+            randomEngine.setStream(t, p, i);
+            measurements[i] = paths[i]->getMeasurement();
+            if (selected.contains(i)) {
                 log.recordSelectedPaths(p, t, i);
             }
-            // rewards.push_back(measurementAtT.b); // get the btlbw measurement as the reward
-            // violations.push_back(measurementAtT.r-threshold); // violation of each selected path
             // record full information of this path
-            log.recordMeasurements(p, t, i, measurementAtT);
+            log.recordMeasurements(p, t, i, measurements[i]);
         }
 
-        policies[p]->updateState(is, measurements);
+        log.endRound(p, t);
 
-        if (1) { // use log to save the selection vector
-            std::cout << "Selected path ID: ";
-            for (const auto& i : is) {
-                std::cout << i << " ";
-            }
-            std::cout << std::endl;
-            std::cout << std::endl;
-        }
+        randomEngine.setStream(t, p, RNG_STREAM_UPDATE);
+        Clock::time_point updateStart = Clock::now();
+        policies[p]->updateState(selected, measurements);
+        Clock::duration decisionTime = selectTime+(Clock::now()-updateStart);
+        decisionTimes[p].add(std::chrono::duration<double, std::nano>(decisionTime).count());
 
-        //double rewardAtT = vectorSum(rewards);
-        //double regretDeltaAtT = oracleRewardAtT-rewardAtT;
-        //double violationAtT = vectorSum(violations);
-        //log.record(p, t, rewardAtT, regretDeltaAtT, violationAtT);
+        olmsLog.logSelection(p, t, is);
     }
 
     void execSingleRoundDamped(Log& log, uint p, uint t)
     {
-        std::vector<uint> is;
-        is = policies[p]->selectNextPaths(M);
-        std::vector<Metric> measurements;
-        std::vector<double> rewards;
-        std::vector<double> violations;
-        Metric measurementAtT;
-        for (const auto& i : is) {
-            measurementAtT = paths[i]->getMeasurement();
-            measurements.push_back(measurementAtT);
-            rewards.push_back(measurementAtT.b); // get the btlbw measurement as the reward
-            violations.push_back(measurementAtT.r-threshold); // violation of each selected path
-        }
-        policies[p]->updateStateDamped(is, measurements);
+        randomEngine.setStream(t, p, RNG_STREAM_SELECT);
+        policies[p]->selectNextPaths(M, is);
+        measureSelected(p, t);
+        randomEngine.setStream(t, p, RNG_STREAM_UPDATE);
+        policies[p]->updateStateDamped(selected, measurements);
 
-        if (1) {
-            std::cout << "Selected path ID: ";
-            for (const auto& i : is) {
-                std::cout << i << " ";
-            }
-            std::cout << std::endl;
-        }
-        double rewardAtT = vectorSum(rewards);
-        double regretDeltaAtT = oracleRewardAtT-rewardAtT;
-        double violationAtT = vectorSum(violations);
-        log.record(p, t, rewardAtT, regretDeltaAtT, violationAtT);
+        olmsLog.logSelection(p, t, is);
+        recordRound(log, p, t);
     }
 
     void execSingleRoundAvg(Log& log, uint p, uint t)
     {
-        std::vector<uint> is;
-        is = policies[p]->selectNextPathsAvg(M);
-        std::vector<Metric> measurements;
-        std::vector<double> rewards;
-        std::vector<double> violations;
-        Metric measurementAtT;
+        randomEngine.setStream(t, p, RNG_STREAM_SELECT);
+        policies[p]->selectNextPathsAvg(M, is);
+        measureSelected(p, t);
+        randomEngine.setStream(t, p, RNG_STREAM_UPDATE);
+        policies[p]->updateStateAvg(selected, measurements);
+
+        olmsLog.logSelection(p, t, is);
+        recordRound(log, p, t);
+    }
+
+private:
+    // measure the paths in is, with their rewards and violations
+    void measureSelected(uint p, uint t)
+    {
+        selected = PathSet<>(is);
+        rewards.clear();
+        violations.clear();
         for (const auto& i : is) {
-            measurementAtT = paths[i]->getMeasurement();
-            measurements.push_back(measurementAtT);
+            randomEngine.setStream(t, p, i);
+            Metric measurementAtT = paths[i]->getMeasurement();
+            measurements[i] = measurementAtT;
             rewards.push_back(measurementAtT.b); // get the btlbw measurement as the reward
             violations.push_back(measurementAtT.r-threshold); // violation of each selected path
         }
-        policies[p]->updateStateAvg(is, measurements);
-
-        if (1) {
-            std::cout << "Selected path ID: ";
-            for (const auto& i : is) {
-                std::cout << i << " ";
-            }
-            std::cout << std::endl;
-        }
+    }
 
+    void recordRound(Log& log, uint p, uint t)
+    {
         double rewardAtT = vectorSum(rewards);
         double regretDeltaAtT = oracleRewardAtT-rewardAtT;
         double violationAtT = vectorSum(violations);
         log.record(p, t, rewardAtT, regretDeltaAtT, violationAtT);
     }
-
 };
 
+// the simulator of the comparison runs, over any policies and paths
+template<class Log = RoundwiseLog>
+using DynamicSimulator = Simulator<Policy, Path, Log>;
+
 } //namespace
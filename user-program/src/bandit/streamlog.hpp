@@ -0,0 +1,234 @@
+#pragma once
+
+#include "macro_util.h"
+#include "bandit_util.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+namespace bandit {
+
+// Binary round log, written while the rounds run:
+//
+//     StreamLogHeader, then P policy names (uint32_t length + bytes),
+//     then one record per (simulation, round, policy):
+//     StreamRecord, then K x {r, b, l} metrics quantized to uint16_t.
+//
+// The records have a fixed width for a given K, the file is averaged
+// offline by the olms-logavg tool.
+
+const char STREAM_LOG_MAGIC[8] = {'O', 'L', 'M', 'S', 'L', 'O', 'G', '1'};
+
+// bytes buffered before a write to the file
+const size_t STREAM_LOG_BUFFER = 1 << 20;
+
+struct StreamLogHeader {
+    char magic[8];
+    uint32_t K;
+    uint32_t P;
+    // rounds per simulation, 0 when running forever
+    uint32_t T;
+    uint32_t reserved;
+};
+
+struct StreamRecord {
+    uint32_t simulation;
+    uint32_t round;
+    uint32_t policy;
+    uint32_t reserved;
+    // bit i is set if path i was selected
+    uint64_t mask;
+};
+
+// the metrics are in [0, 1]
+inline uint16_t quantizeMetric(double v)
+{
+    v = std::min(std::max(v, 0.0), 1.0);
+    return (uint16_t) (v*65535.0+0.5);
+}
+
+inline double dequantizeMetric(uint16_t q)
+{
+    return q/65535.0;
+}
+
+inline size_t streamRecordSize(uint K)
+{
+    return sizeof(StreamRecord)+3*K*sizeof(uint16_t);
+}
+
+// Log with the interface of RoundwiseFullLog that appends every round to
+// a file through a fixed buffer, so its memory does not grow with T. It
+// also logs in the forever mode.
+class StreamingLog {
+public:
+
+    uint P, T, K, simulationTimes;
+    bool forever;
+
+    StreamingLog(uint P, uint T, uint K, bool isForever_, const std::string& file,
+            const std::vector<std::string>& policyNames)
+            :P(P), T(T), K(K), simulationTimes(0), forever(isForever_),
+             out(NULL), used(0), mask(0), metrics(3*K, 0)
+    {
+        buffer.resize(STREAM_LOG_BUFFER);
+        out = std::fopen(file.c_str(), "wb");
+        if (out==NULL) {
+            std::cerr << "StreamingLog: cannot open " << file << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        StreamLogHeader header;
+        std::memcpy(header.magic, STREAM_LOG_MAGIC, sizeof(header.magic));
+        header.K = K;
+        header.P = P;
+        header.T = forever ? 0 : T;
+        header.reserved = 0;
+        append(&header, sizeof(header));
+        for (const auto& name : policyNames) {
+            const uint32_t len = name.size();
+            append(&len, sizeof(len));
+            append(name.data(), len);
+        }
+    }
+
+    ~StreamingLog()
+    {
+        close();
+    }
+
+    //start new simulation
+    void addSimulation()
+    {
+        simulationTimes += 1;
+    }
+
+    void recordMeasurements(uint p, uint t, uint i, Metric m)
+    {
+        metrics[3*i] = quantizeMetric(m.r);
+        metrics[3*i+1] = quantizeMetric(m.b);
+        metrics[3*i+2] = quantizeMetric(m.l);
+    }
+
+    void recordSelectedPaths(uint p, uint t, uint i)
+    {
+        mask |= uint64_t(1) << i;
+    }
+
+    // policy p finished round t, append its record
+    void endRound(uint p, uint t)
+    {
+        StreamRecord record;
+        record.simulation = simulationTimes-1;
+        record.round = t;
+        record.policy = p;
+        record.reserved = 0;
+        record.mask = mask;
+        append(&record, sizeof(record));
+        append(metrics.data(), metrics.size()*sizeof(uint16_t));
+        mask = 0;
+    }
+
+    // write what is buffered and close the file
+    void close()
+    {
+        if (out!=NULL) {
+            flush();
+            std::fclose(out);
+            out = NULL;
+        }
+    }
+
+private:
+    std::FILE* out;
+    std::vector<char> buffer;
+    size_t used;
+    uint64_t mask;
+    std::vector<uint16_t> metrics;
+
+    void append(const void* data, size_t n)
+    {
+        if (used+n>buffer.size()) {
+            flush();
+        }
+        std::memcpy(buffer.data()+used, data, n);
+        used += n;
+    }
+
+    void flush()
+    {
+        if (used>0 && std::fwrite(buffer.data(), 1, used, out)!=used) {
+            std::cerr << "StreamingLog: write failed" << std::endl;
+            abort();
+        }
+        used = 0;
+    }
+};
+
+// Reads the file of a StreamingLog record by record.
+class StreamLogReader {
+public:
+    StreamLogHeader header;
+    std::vector<std::string> policyNames;
+
+    explicit StreamLogReader(const std::string& file)
+            :in(std::fopen(file.c_str(), "rb"))
+    {
+        if (in==NULL) {
+            std::cerr << "StreamLogReader: cannot open " << file << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (std::fread(&header, sizeof(header), 1, in)!=1
+                || std::memcmp(header.magic, STREAM_LOG_MAGIC, sizeof(header.magic))!=0) {
+            std::cerr << "StreamLogReader: " << file << " is not a stream log" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        for (uint p = 0; p<header.P; ++p) {
+            uint32_t len;
+            if (std::fread(&len, sizeof(len), 1, in)!=1) {
+                std::cerr << "StreamLogReader: truncated header" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            std::string name(len, ' ');
+            if (len>0 && std::fread(&name[0], 1, len, in)!=len) {
+                std::cerr << "StreamLogReader: truncated header" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            policyNames.push_back(name);
+        }
+        firstRecord = std::ftell(in);
+        quantized.resize(3*header.K);
+    }
+
+    ~StreamLogReader()
+    {
+        std::fclose(in);
+    }
+
+    // the next record and its K metrics, false at the end of the file
+    bool next(StreamRecord& record, std::vector<Metric>& metrics)
+    {
+        if (std::fread(&record, sizeof(record), 1, in)!=1
+                || std::fread(quantized.data(), sizeof(uint16_t), quantized.size(), in)!=quantized.size()) {
+            return false;
+        }
+        metrics.resize(header.K);
+        for (uint i = 0; i<header.K; ++i) {
+            metrics[i].r = dequantizeMetric(quantized[3*i]);
+            metrics[i].b = dequantizeMetric(quantized[3*i+1]);
+            metrics[i].l = dequantizeMetric(quantized[3*i+2]);
+        }
+        return true;
+    }
+
+    void rewind()
+    {
+        std::fseek(in, firstRecord, SEEK_SET);
+    }
+
+private:
+    std::FILE* in;
+    long firstRecord;
+    std::vector<uint16_t> quantized;
+};
+
+} //namespace
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "macro_util.h"
+#include "bandit_util.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bandit {
+
+// Binary trace of the measurements of K paths:
+//
+//     TraceHeader, then one row per round: K x {r, b, l} as float.
+//
+// The number of rounds follows from the file size, so a trace of a run
+// that was killed is still readable up to its last whole row.
+
+const char TRACE_MAGIC[8] = {'O', 'L', 'M', 'S', 'T', 'R', 'C', '1'};
+
+// bytes buffered before a write to the file
+const size_t TRACE_BUFFER = 1 << 16;
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t K;
+    uint32_t reserved;
+};
+
+inline size_t traceRowSize(uint K)
+{
+    return 3*K*sizeof(float);
+}
+
+// Appends the measurements of the kernel, a row per round.
+class TraceWriter {
+public:
+    TraceWriter(const std::string& file, uint K)
+            :K(K), out(std::fopen(file.c_str(), "wb")), row(3*K)
+    {
+        if (out==NULL) {
+            std::cerr << "TraceWriter: cannot open " << file << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        std::setvbuf(out, NULL, _IOFBF, TRACE_BUFFER);
+        TraceHeader header;
+        std::memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+        header.K = K;
+        header.reserved = 0;
+        write(&header, sizeof(header));
+    }
+
+    ~TraceWriter()
+    {
+        close();
+    }
+
+    // the first K entries of r, b and l
+    void append(const std::vector<double>& r, const std::vector<double>& b, const std::vector<double>& l)
+    {
+        for (uint i = 0; i<K; ++i) {
+            row[3*i] = (float) r[i];
+            row[3*i+1] = (float) b[i];
+            row[3*i+2] = (float) l[i];
+        }
+        write(row.data(), traceRowSize(K));
+    }
+
+    void close()
+    {
+        if (out!=NULL) {
+            std::fclose(out);
+            out = NULL;
+        }
+    }
+
+private:
+    uint K;
+    std::FILE* out;
+    std::vector<float> row;
+
+    void write(const void* data, size_t n)
+    {
+        if (std::fwrite(data, 1, n, out)!=n) {
+            std::cerr << "TraceWriter: write failed" << std::endl;
+            abort();
+        }
+    }
+};
+
+// A trace mapped read-only into memory. The rows are shared by the
+// ReplayPaths of all runs and threads.
+class TraceReader {
+public:
+    explicit TraceReader(const std::string& file)
+            :base(NULL), length(0)
+    {
+        int fd = ::open(file.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd==-1 || fstat(fd, &st)==-1) {
+            std::cerr << "TraceReader: cannot open " << file << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        length = st.st_size;
+        if (length<sizeof(TraceHeader)) {
+            std::cerr << "TraceReader: " << file << " is not a trace" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        void* p = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p==MAP_FAILED) {
+            std::cerr << "TraceReader: cannot map " << file << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        base = static_cast<const char*>(p);
+        const TraceHeader* header = reinterpret_cast<const TraceHeader*>(base);
+        if (std::memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic))!=0
+                || header->K==0 || header->K>MAX_NUM_PATHS) {
+            std::cerr << "TraceReader: " << file << " is not a trace" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        K = header->K;
+        rounds = (length-sizeof(TraceHeader))/traceRowSize(K);
+        if (rounds==0) {
+            std::cerr << "TraceReader: " << file << " has no rounds" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        rows = reinterpret_cast<const float*>(base+sizeof(TraceHeader));
+        // sequential reads, let the kernel read ahead
+        madvise(p, length, MADV_SEQUENTIAL);
+    }
+
+    ~TraceReader()
+    {
+        if (base!=NULL) {
+            munmap(const_cast<char*>(base), length);
+        }
+    }
+
+    TraceReader(const TraceReader&) = delete;
+
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    uint getK() const { return K; }
+
+    uint64_t getRounds() const { return rounds; }
+
+    // the K x {r, b, l} of round t, a trace repeats when t passes its end
+    const float* row(uint64_t t) const
+    {
+        return rows+(t%rounds)*3*K;
+    }
+
+    // the mean of path i over the whole trace
+    Metric mean(uint i) const
+    {
+        double r = 0, b = 0, l = 0;
+        for (uint64_t t = 0; t<rounds; ++t) {
+            const float* m = row(t)+3*i;
+            r += m[0];
+            b += m[1];
+            l += m[2];
+        }
+        return Metric(r/rounds, b/rounds, l/rounds);
+    }
+
+private:
+    const char* base;
+    size_t length;
+    uint K;
+    uint64_t rounds;
+    const float* rows;
+};
+
+} //namespace
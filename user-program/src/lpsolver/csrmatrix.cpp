@@ -0,0 +1,125 @@
+//
+// Created by kccai.
+//
+
+#include "../bandit/macro_util.h"
+#include "csrmatrix.h"
+
+#include <iostream>
+
+CSRMatrix::CSRMatrix(int cols)
+        :m_cols(cols), m_rowPtr(1, 0)
+{
+}
+
+CSRMatrix::CSRMatrix(Matrix& m)
+        :m_cols(m.numCols()), m_rowPtr(1, 0)
+{
+    assign(m);
+}
+
+void CSRMatrix::assign(Matrix& m)
+{
+    clear(m.numCols());
+    for (int i = 0; i<m.numRows(); ++i) {
+        for (int j = 0; j<m_cols; ++j) {
+            if (m[i][j]!=0) {
+                push(j, m[i][j]);
+            }
+        }
+        nextRow();
+    }
+}
+
+void CSRMatrix::clear(int cols)
+{
+    m_cols = cols;
+    m_rowPtr.resize(1);
+    m_colIdx.clear();
+    m_values.clear();
+}
+
+void CSRMatrix::push(int col, double value)
+{
+    m_colIdx.push_back(col);
+    m_values.push_back(value);
+}
+
+void CSRMatrix::nextRow()
+{
+    m_rowPtr.push_back((int) m_colIdx.size());
+}
+
+int CSRMatrix::numRows() const
+{
+    return (int) m_rowPtr.size()-1;
+}
+
+int CSRMatrix::numCols() const
+{
+    return m_cols;
+}
+
+int CSRMatrix::numNonZeros() const
+{
+    return m_rowPtr.back();
+}
+
+int CSRMatrix::rowBegin(int row) const
+{
+    return m_rowPtr[row];
+}
+
+int CSRMatrix::rowEnd(int row) const
+{
+    return m_rowPtr[row+1];
+}
+
+int CSRMatrix::col(int k) const
+{
+    return m_colIdx[k];
+}
+
+double CSRMatrix::value(int k) const
+{
+    return m_values[k];
+}
+
+double CSRMatrix::at(int row, int col) const
+{
+    for (int k = m_rowPtr[row]; k<m_rowPtr[row+1]; ++k) {
+        if (m_colIdx[k]==col) {
+            return m_values[k];
+        }
+    }
+    return 0.0;
+}
+
+bool CSRMatrix::sameRow(const CSRMatrix& s, int row) const
+{
+    const int b = m_rowPtr[row], e = m_rowPtr[row+1];
+    const int sb = s.m_rowPtr[row], se = s.m_rowPtr[row+1];
+    if (e-b!=se-sb) {
+        return false;
+    }
+    for (int k = 0; k<e-b; ++k) {
+        if (m_colIdx[b+k]!=s.m_colIdx[sb+k] || m_values[b+k]!=s.m_values[sb+k]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CSRMatrix::printMat(const char* name) const
+{
+#if DEBUG_mode
+    std::cout << name << ": " << std::endl;
+    for (int i = 0; i<numRows(); ++i) {
+        for (int j = 0; j<m_cols; ++j) {
+            std::cout << at(i, j) << " ";
+        }
+        std::cout << std::endl;
+    }
+    std::cout << std::endl;
+#endif
+}
@@ -0,0 +1,65 @@
+//
+// Created by kccai.
+//
+
+#pragma once
+
+#include "matrix.h"
+
+#include <vector>
+#include <string>
+
+// Compressed sparse row matrix. Rows are appended in order:
+//
+//     CSRMatrix A(N);
+//     A.push(0, 1.0); A.push(3, 2.0); A.nextRow();   // row 0
+//     A.nextRow();                                   // row 1 is empty
+//
+// clear() keeps the capacity, so a matrix rebuilt every round with the
+// same pattern does not allocate after the first round.
+class CSRMatrix {
+public:
+    explicit CSRMatrix(int cols = 0);
+
+    // keeps the non-zero cells of a dense matrix
+    explicit CSRMatrix(Matrix& m);
+
+    void clear(int cols);
+
+    // the non-zero cells of a dense matrix in place of the rows, without
+    // allocating once the capacity is reached
+    void assign(Matrix& m);
+
+    // append a cell to the current row, columns in increasing order
+    void push(int col, double value);
+
+    // close the current row
+    void nextRow();
+
+    int numRows() const;
+
+    int numCols() const;
+
+    int numNonZeros() const;
+
+    int rowBegin(int row) const;
+
+    int rowEnd(int row) const;
+
+    int col(int k) const;
+
+    double value(int k) const;
+
+    // the cell (row, col), zero if not stored
+    double at(int row, int col) const;
+
+    bool sameRow(const CSRMatrix& s, int row) const;
+
+    void printMat(const char* name) const;
+
+private:
+    int m_cols;
+    std::vector<int> m_rowPtr;
+    std::vector<int> m_colIdx;
+    std::vector<double> m_values;
+};
@@ -14,16 +14,37 @@ using std::string;
 using std::cout;
 using std::endl;
 
+LPSolver::LPSolver()
+        :m_M(0),
+         m_N(0),
+         m_Fix(0),
+         m_maximize(false),
+         m_lp(NULL)
+{
+}
+
 LPSolver::LPSolver(Matrix& m, const vector<double>& b, const vector<double>& c, const double& Fix)
         :m_M(m.numRows()),
-         m_N(m[0].size()),
+         m_N(m.numCols()),
          m_c(c),
          m_b(b),
          m_A(m),
          m_Fix(Fix),
-         m_lp(glp_create_prob())
+         m_maximize(false),
+         m_lp(NULL)
+{
+}
+
+LPSolver::LPSolver(const CSRMatrix& m, const vector<double>& b, const vector<double>& c, const double& Fix)
+        :m_M(m.numRows()),
+         m_N(m.numCols()),
+         m_c(c),
+         m_b(b),
+         m_A(m),
+         m_Fix(Fix),
+         m_maximize(false),
+         m_lp(NULL)
 {
-    initProblem(m_M, m_N);
 }
 
 LPSolver::LPSolver(const LPSolver& p)
@@ -33,81 +54,175 @@ LPSolver::LPSolver(const LPSolver& p)
          m_b(p.m_b),
          m_A(p.m_A),
          m_Fix(p.m_Fix),
-         m_lp(glp_create_prob())
+         m_maximize(p.m_maximize),
+         m_name(p.m_name),
+         m_lp(NULL)
 {
+}
+
+// the GLPK problem is built on the first general solve
+void LPSolver::createProblem()
+{
+    if (m_lp) return;
+    m_lp = glp_create_prob();
+    if (!m_lp) return;
+    if (!m_name.empty()) {
+        glp_set_prob_name(m_lp, m_name.c_str());
+    }
+    glp_set_obj_dir(m_lp, m_maximize ? GLP_MAX : GLP_MIN);
     initProblem(m_M, m_N);
 }
 
 // performs necessary initialization of the given values
-void LPSolver::initProblem(size_t M, size_t N)
+void LPSolver::initProblem(size_t M, size_t)
 {
     if (!m_lp) return;
 
     setRowBounds();
     setColumnCoefs();
 
-    vector<int> I, J;
-    vector<double> V;
+    // only the stored cells are loaded
+    const int nnz = m_A.numNonZeros();
+    vector<int> I(nnz+1, 0), J(nnz+1, 0);
+    vector<double> V(nnz+1, 0.0);
 
     // indices in GLPK start on 1
-    I.push_back(0);
-    J.push_back(0);
-    V.push_back(0);
-    for (int i = 0; i<M; ++i) {
-        for (int j = 0; j<N; ++j) {
-            I.push_back(i+1);
-            J.push_back(j+1);
-            V.push_back(m_A[i][j]);
+    for (size_t i = 0; i<M; ++i) {
+        for (int k = m_A.rowBegin((int) i); k<m_A.rowEnd((int) i); ++k) {
+            I[k+1] = (int) i+1;
+            J[k+1] = m_A.col(k)+1;
+            V[k+1] = m_A.value(k);
+        }
+    }
+    glp_load_matrix(m_lp, nnz, &I[0], &J[0], &V[0]);
+}
+
+void LPSolver::update(Matrix& A, const vector<double>& b, const vector<double>& c, const double& Fix)
+{
+    m_dense.assign(A);
+    update(m_dense, b, c, Fix);
+}
+
+void LPSolver::update(const CSRMatrix& A, const vector<double>& b, const vector<double>& c, const double& Fix)
+{
+    if (m_lp && ((size_t) A.numRows()!=m_M || (size_t) A.numCols()!=m_N)) {
+        // a different problem size, rebuild on the next general solve
+        glp_delete_prob(m_lp);
+        m_lp = NULL;
+    }
+    if (m_lp) {
+        updateRows(A);
+        updateBounds(b, Fix);
+        updateObjective(c);
+    }
+    m_M = A.numRows();
+    m_N = A.numCols();
+    m_A = A;
+    m_b = b;
+    m_c = c;
+    m_Fix = Fix;
+}
+
+void LPSolver::updateRows(const CSRMatrix& A)
+{
+    m_ind.resize(m_N+1);
+    m_val.resize(m_N+1);
+    for (size_t i = 0; i<m_M; ++i) {
+        if (m_A.sameRow(A, (int) i)) {
+            continue;
+        }
+        int len = 0;
+        for (int k = A.rowBegin((int) i); k<A.rowEnd((int) i); ++k) {
+            ++len;
+            m_ind[len] = A.col(k)+1;
+            m_val[len] = A.value(k);
+        }
+        glp_set_mat_row(m_lp, (int) i+1, len, &m_ind[0], &m_val[0]);
+    }
+}
+
+void LPSolver::updateBounds(const vector<double>& b, double Fix)
+{
+    for (size_t i = 0; i+1<m_M; ++i) {
+        if (b[i]!=m_b[i]) {
+            glp_set_row_bnds(m_lp, (int) i+1, GLP_UP, 0.0, b[i]);
+        }
+    }
+    if (Fix!=m_Fix) {
+        glp_set_row_bnds(m_lp, (int) m_M, GLP_FX, Fix, Fix);
+    }
+}
+
+void LPSolver::updateObjective(const vector<double>& c)
+{
+    for (size_t j = 0; j<m_N; ++j) {
+        if (c[j]!=m_c[j]) {
+            glp_set_obj_coef(m_lp, (int) j+1, c[j]);
         }
     }
-    glp_load_matrix(m_lp, (int) (m_M*m_N), &I[0], &J[0], &V[0]);
 }
 
 LPSolver::~LPSolver()
 {
-    glp_delete_prob(m_lp);
+    if (m_lp) {
+        glp_delete_prob(m_lp);
+    }
 }
 
 LPSolver& LPSolver::operator=(const LPSolver& p)
 {
     if (this!=&p) {
+        if (m_lp) {
+            glp_delete_prob(m_lp);
+            m_lp = NULL;
+        }
         m_M = p.m_M;
         m_N = p.m_N;
         m_c = p.m_c;
         m_b = p.m_b;
         m_A = p.m_A;
-        m_lp = glp_create_prob();
-        initProblem(m_M, m_N);
+        m_Fix = p.m_Fix;
+        m_maximize = p.m_maximize;
+        m_name = p.m_name;
     }
     return *this;
 }
 
 void LPSolver::setName(const std::string& s)
 {
-    glp_set_prob_name(m_lp, s.c_str());
+    m_name = s;
+    if (m_lp) {
+        glp_set_prob_name(m_lp, s.c_str());
+    }
 }
 
 bool LPSolver::isValid()
 {
-    return m_lp!=NULL;
+    return m_M>0 && m_N>0;
 }
 
 void LPSolver::setMaximization()
 {
-    glp_set_obj_dir(m_lp, GLP_MAX);
+    m_maximize = true;
+    if (m_lp) {
+        glp_set_obj_dir(m_lp, GLP_MAX);
+    }
 }
 
 void LPSolver::setMinimization()
 {
-    glp_set_obj_dir(m_lp, GLP_MIN);
+    m_maximize = false;
+    if (m_lp) {
+        glp_set_obj_dir(m_lp, GLP_MIN);
+    }
 }
 
 // this function is important !!!
 void LPSolver::setRowBounds()
 {
     glp_add_rows(m_lp, (int) m_M);
-    for (int i = 0; i<m_M-1; ++i) {
-        glp_set_row_bnds(m_lp, i+1, GLP_UP, 0.0, m_b[i]);
+    for (size_t i = 0; i+1<m_M; ++i) {
+        glp_set_row_bnds(m_lp, (int) i+1, GLP_UP, 0.0, m_b[i]);
     }
     // Only consider a single equality constraint!
     glp_set_row_bnds(m_lp, (int) m_M, GLP_FX, m_Fix, m_Fix); // last Fix constraint
@@ -117,15 +232,28 @@ void LPSolver::setRowBounds()
 void LPSolver::setColumnCoefs()
 {
     glp_add_cols(m_lp, (int) m_N);
-    for (int j = 0; j<m_N; ++j) {
+    for (size_t j = 0; j<m_N; ++j) {
         // double side constraint for each v_i
-        glp_set_col_bnds(m_lp, j+1, GLP_DB, 0.0, 1.0);
-        glp_set_obj_coef(m_lp, j+1, m_c[j]);
+        glp_set_col_bnds(m_lp, (int) j+1, GLP_DB, 0.0, 1.0);
+        glp_set_obj_coef(m_lp, (int) j+1, m_c[j]);
     }
 }
 
 LPSolver::LPStatus LPSolver::solve(std::vector<double>& result)
 {
+    // the ConMPTS problems are solved without GLPK
+    StructuredLP::Shape shape = m_fast.detect(m_A, m_b, m_c, m_maximize);
+    if (shape!=StructuredLP::GENERAL) {
+        if (m_fast.solve(shape, m_b, m_c, m_Fix, m_maximize, result)) {
+            return LPSolver::FEASIBLE;
+        }
+        return LPSolver::ERROR;
+    }
+
+    createProblem();
+    if (!m_lp) {
+        return LPSolver::ERROR;
+    }
 
     // m_A.printMat("LP-A:");
     // set the LP parameters
@@ -134,12 +262,12 @@ LPSolver::LPStatus LPSolver::solve(std::vector<double>& result)
     parm.msg_lev = GLP_MSG_ERR;
     parm.meth = GLP_DUALP;
     int LP_ENUM = glp_simplex(m_lp, &parm);
-    if (LP_ENUM==0) {
+    if (LP_ENUM==0 && glp_get_status(m_lp)==GLP_OPT) {
         // resized here!!!
         result.resize(m_N, 0);
         // objValue = glp_get_obj_val(m_lp);
-        for (int j = 0; j<m_N; ++j) {
-            result[j] = glp_get_col_prim(m_lp, j+1);
+        for (size_t j = 0; j<m_N; ++j) {
+            result[j] = glp_get_col_prim(m_lp, (int) j+1);
         }
 
         return LPSolver::FEASIBLE;
@@ -157,6 +285,7 @@ LPSolver::LPStatus LPSolver::solve(std::vector<double>& result)
 
 glp_prob* LPSolver::getLP()
 {
+    createProblem();
     return m_lp;
 }
 
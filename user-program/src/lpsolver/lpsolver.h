@@ -5,6 +5,8 @@
 #pragma once
 
 #include "matrix.h"
+#include "csrmatrix.h"
+#include "structuredlp.h"
 
 #include <vector>
 #include <string>
@@ -13,8 +15,13 @@ struct glp_prob;
 
 class LPSolver {
 public:
+    // an empty solver, the problem is given with update()
+    LPSolver();
+
     LPSolver(Matrix& A, const std::vector<double>& b, const std::vector<double>& c, const double&  Fix);
 
+    LPSolver(const CSRMatrix& A, const std::vector<double>& b, const std::vector<double>& c, const double& Fix);
+
     LPSolver(const LPSolver& p);
 
     ~LPSolver();
@@ -28,6 +35,13 @@ enum LPStatus {
 
     virtual LPStatus solve(std::vector<double>& result);
 
+    // Replace the problem data. A GLPK problem of the same size is kept
+    // alive and only the changed rows, bounds and objective coefficients
+    // are written, so the next solve restarts from the last optimal basis.
+    void update(const CSRMatrix& A, const std::vector<double>& b, const std::vector<double>& c, const double& Fix);
+
+    void update(Matrix& A, const std::vector<double>& b, const std::vector<double>& c, const double& Fix);
+
     void setName(const std::string& s);
 
     bool isValid();
@@ -41,9 +55,20 @@ private:
     size_t m_N;
     std::vector<double> m_c;
     std::vector<double> m_b; //
+    CSRMatrix m_A;
     double m_Fix;  /* FIX equal row bound*/
-    Matrix m_A;
+    bool m_maximize;
+    std::string m_name;
+    StructuredLP m_fast;
+    // only created when the problem has no closed-form solver
     glp_prob* m_lp;
+    // the dense matrix of the last update(Matrix&, ...), refilled in place
+    CSRMatrix m_dense;
+    // scratch for glp_set_mat_row
+    std::vector<int> m_ind;
+    std::vector<double> m_val;
+
+    void createProblem();
 
     void initProblem(size_t M, size_t N);
 
@@ -51,6 +76,12 @@ private:
 
     void setColumnCoefs();
 
+    void updateRows(const CSRMatrix& A);
+
+    void updateBounds(const std::vector<double>& b, double Fix);
+
+    void updateObjective(const std::vector<double>& c);
+
 protected:
     glp_prob* getLP();
 
@@ -7,52 +7,132 @@
 
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
-Matrix::Matrix(int size)
+namespace {
+
+// doubles per cache line; rows are padded to a multiple of it
+const int MATRIX_ALIGN = 8;
+
+// block edge of the multiply loops, 3 blocks of 64x64 doubles fit in L2
+const int MATRIX_BLOCK = 64;
+
+// out[i][j] += a[i][k] * b[k][j] over the whole range, blocked on i, k and j
+void multiplyBlocked(double* out, int os, const double* a, int as, const double* b, int bs,
+        int rows, int inner, int cols)
 {
-    for (int i = 0; i<size; ++i) {
-        std::vector<double> row(size, 0);
-        m_rows.push_back(row);
+    for (int i0 = 0; i0<rows; i0 += MATRIX_BLOCK) {
+        const int i1 = std::min(i0+MATRIX_BLOCK, rows);
+        for (int k0 = 0; k0<inner; k0 += MATRIX_BLOCK) {
+            const int k1 = std::min(k0+MATRIX_BLOCK, inner);
+            for (int j0 = 0; j0<cols; j0 += MATRIX_BLOCK) {
+                const int j1 = std::min(j0+MATRIX_BLOCK, cols);
+                for (int i = i0; i<i1; ++i) {
+                    double* __restrict__ outRow = out+(size_t) i*os;
+                    for (int k = k0; k<k1; ++k) {
+                        const double aik = a[(size_t) i*as+k];
+                        const double* __restrict__ bRow = b+(size_t) k*bs;
+                        for (int j = j0; j<j1; ++j) {
+                            outRow[j] += aik*bRow[j];
+                        }
+                    }
+                }
+            }
+        }
     }
 }
 
-Matrix::Matrix(int size, int size2)
+} // namespace
+
+int Matrix::strideOf(int cols)
+{
+    return (cols+MATRIX_ALIGN-1)/MATRIX_ALIGN*MATRIX_ALIGN;
+}
+
+double* Matrix::allocate(size_t n)
 {
-    for (int i = 0; i<size; ++i) {
-        std::vector<double> row(size2, 0);
-        m_rows.push_back(row);
+    if (n==0) {
+        return NULL;
+    }
+    void* p = NULL;
+    if (posix_memalign(&p, MATRIX_ALIGN*sizeof(double), n*sizeof(double))!=0) {
+        throw std::bad_alloc();
     }
+    std::memset(p, 0, n*sizeof(double));
+    return static_cast<double*>(p);
+}
+
+Matrix::Matrix(int size)
+        :m_rows(size), m_cols(size), m_stride(strideOf(size)),
+         m_data(NULL), m_capacity((size_t) size*strideOf(size)),
+         m_scratch(NULL), m_scratchCapacity(0)
+{
+    m_data = allocate(m_capacity);
+}
+
+Matrix::Matrix(int size, int size2)
+        :m_rows(size), m_cols(size2), m_stride(strideOf(size2)),
+         m_data(NULL), m_capacity((size_t) size*strideOf(size2)),
+         m_scratch(NULL), m_scratchCapacity(0)
+{
+    m_data = allocate(m_capacity);
 }
 
 Matrix::Matrix(const Matrix& s)
-        :m_rows(s.m_rows)
+        :m_rows(s.m_rows), m_cols(s.m_cols), m_stride(s.m_stride),
+         m_data(NULL), m_capacity((size_t) s.m_rows*s.m_stride),
+         m_scratch(NULL), m_scratchCapacity(0)
 {
+    m_data = allocate(m_capacity);
+    if (m_capacity) {
+        std::memcpy(m_data, s.m_data, m_capacity*sizeof(double));
+    }
 }
 
 Matrix::~Matrix()
 {
+    std::free(m_data);
+    std::free(m_scratch);
 }
 
 Matrix& Matrix::operator=(const Matrix& s)
 {
     if (this!=&s) {
+        const size_t n = (size_t) s.m_rows*s.m_stride;
+        if (n>m_capacity) {
+            std::free(m_data);
+            m_data = allocate(n);
+            m_capacity = n;
+        }
         m_rows = s.m_rows;
+        m_cols = s.m_cols;
+        m_stride = s.m_stride;
+        if (n) {
+            std::memcpy(m_data, s.m_data, n*sizeof(double));
+        }
     }
     return *this;
 }
 
-Matrix::Row& Matrix::operator[](int pos)
+Matrix::Row Matrix::operator[](int pos)
+{
+    return m_data+(size_t) pos*m_stride;
+}
+
+const double* Matrix::operator[](int pos) const
 {
-    return m_rows[pos];
+    return m_data+(size_t) pos*m_stride;
 }
 
-void Matrix::printMat(const std::string& name) const
+void Matrix::printMat(const char* name) const
 {
 #if DEBUG_mode
-    std::cout << name+": " << std::endl;
-    for (unsigned i = 0; i<m_rows.size(); ++i) {
-        for (unsigned j = 0; j<m_rows[0].size(); ++j) {
-            std::cout << m_rows[i][j]<<" ";
+    std::cout << name << ": " << std::endl;
+    for (int i = 0; i<m_rows; ++i) {
+        for (int j = 0; j<m_cols; ++j) {
+            std::cout << (*this)[i][j] << " ";
         }
         std::cout << std::endl;
     }
@@ -60,80 +140,111 @@ void Matrix::printMat(const std::string& name) const
 #endif
 }
 
+void Matrix::reserveScratch(size_t n)
+{
+    if (n>m_scratchCapacity) {
+        std::free(m_scratch);
+        m_scratch = allocate(n);
+        m_scratchCapacity = n;
+    }
+}
+
+// the scratch buffer holds the new rows x cols content, make it current
+void Matrix::swapScratch(int rows, int cols)
+{
+    std::swap(m_data, m_scratch);
+    std::swap(m_capacity, m_scratchCapacity);
+    m_rows = rows;
+    m_cols = cols;
+    m_stride = strideOf(cols);
+}
+
 void Matrix::transpose()
 {
-    std::vector<Row> rows;
-    for (unsigned i = 0; i<m_rows[0].size(); ++i) {
-        std::vector<double> row;
-        for (unsigned j = 0; j<m_rows.size(); ++j) {
-            row[j] = m_rows[j][i];
+    const int stride = strideOf(m_rows);
+    reserveScratch((size_t) m_cols*stride);
+    for (int i = 0; i<m_rows; ++i) {
+        const double* row = (*this)[i];
+        for (int j = 0; j<m_cols; ++j) {
+            m_scratch[(size_t) j*stride+i] = row[j];
         }
-        rows.push_back(row);
     }
-    m_rows.swap(rows);
+    swapScratch(m_cols, m_rows);
 }
 
 double Matrix::trace()
 {
-    if (m_rows.size()!=m_rows[0].size()) {
+    if (m_rows!=m_cols) {
         return 0;
     }
     double total = 0;
-    for (unsigned i = 0; i<m_rows.size(); ++i) {
-        total += m_rows[i][i];
+    for (int i = 0; i<m_rows; ++i) {
+        total += (*this)[i][i];
     }
     return total;
 }
 
 void Matrix::add(const Matrix& s)
 {
-    if (m_rows.size()!=s.m_rows.size() ||
-            m_rows[0].size()!=s.m_rows[0].size()) {
+    if (m_rows!=s.m_rows || m_cols!=s.m_cols) {
         throw new std::runtime_error("invalid matrix dimensions");
     }
-    for (unsigned i = 0; i<m_rows.size(); ++i) {
-        for (unsigned j = 0; j<m_rows[0].size(); ++j) {
-            m_rows[i][j] += s.m_rows[i][j];
-        }
+    // same shape, same stride: one flat loop over the padded buffer
+    const size_t n = (size_t) m_rows*m_stride;
+    double* __restrict__ d = m_data;
+    const double* __restrict__ o = s.m_data;
+    for (size_t k = 0; k<n; ++k) {
+        d[k] += o[k];
     }
 }
 
 void Matrix::subtract(const Matrix& s)
 {
-    if (m_rows.size()!=s.m_rows.size() ||
-            m_rows[0].size()!=s.m_rows[0].size()) {
+    if (m_rows!=s.m_rows || m_cols!=s.m_cols) {
         throw new std::runtime_error("invalid matrix dimensions");
     }
-    for (unsigned i = 0; i<m_rows.size(); ++i) {
-        for (unsigned j = 0; j<m_rows[0].size(); ++j) {
-            m_rows[i][j] += s.m_rows[i][j];
-        }
+    const size_t n = (size_t) m_rows*m_stride;
+    double* __restrict__ d = m_data;
+    const double* __restrict__ o = s.m_data;
+    for (size_t k = 0; k<n; ++k) {
+        d[k] -= o[k];
     }
 }
 
 void Matrix::multiply(const Matrix& s)
 {
-    if (m_rows[0].size()!=s.m_rows.size()) {
+    multiply(*this, s);
+}
+
+void Matrix::multiply(const Matrix& a, const Matrix& b)
+{
+    if (a.m_cols!=b.m_rows) {
         throw new std::runtime_error("invalid matrix dimensions");
     }
-    std::vector<Row> rows;
-    for (unsigned i = 0; i<m_rows.size(); ++i) {
-        std::vector<double> row;
-        for (unsigned j = 0; j<s.m_rows.size(); ++j) {
-            double Mij = 0;
-            for (unsigned k = 0; k<m_rows[0].size(); ++k) {
-                Mij += m_rows[i][k]*s.m_rows[k][j];
-            }
-            row.push_back(Mij);
-        }
-        rows.push_back(row);
+    const int stride = strideOf(b.m_cols);
+    const size_t n = (size_t) a.m_rows*stride;
+    reserveScratch(n);
+    if (n) {
+        std::memset(m_scratch, 0, n*sizeof(double));
     }
-    m_rows.swap(rows);
+    multiplyBlocked(m_scratch, stride, a.m_data, a.m_stride, b.m_data, b.m_stride,
+            a.m_rows, a.m_cols, b.m_cols);
+    swapScratch(a.m_rows, b.m_cols);
 }
 
 int Matrix::numRows() const
 {
-    return m_rows.size();
+    return m_rows;
+}
+
+int Matrix::numCols() const
+{
+    return m_cols;
+}
+
+int Matrix::stride() const
+{
+    return m_stride;
 }
 
 Matrix operator+(const Matrix& s1, const Matrix& s2)
@@ -156,5 +267,3 @@ Matrix operator*(const Matrix& s1, const Matrix& s2)
     s.multiply(s2);
     return s;
 }
-
-
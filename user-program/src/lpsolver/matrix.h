@@ -4,12 +4,20 @@
 
 #pragma once
 
+#include <cstddef>
 #include <vector>
 #include <string>
 
+// Dense row-major matrix on one contiguous, 64-byte aligned buffer.
+// Rows are padded to a multiple of 8 doubles, so every row starts on a
+// cache line; m[i][j] is m.data()[i*stride()+j].
+//
+// The storage is only reallocated when a matrix grows. multiply() and
+// transpose() compute into a second buffer that is kept for later calls,
+// so a matrix of fixed shape does not allocate after construction.
 class Matrix {
 public:
-    typedef std::vector<double> Row;
+    typedef double* Row;
 
     Matrix(int size);
 
@@ -29,16 +37,41 @@ public:
 
     void subtract(const Matrix& s);
 
+    // this = this * s
     void multiply(const Matrix& s);
 
-    Row& operator[](int pos);
+    // this = a * b, either may be this matrix
+    void multiply(const Matrix& a, const Matrix& b);
+
+    Row operator[](int pos);
+
+    const double* operator[](int pos) const;
 
     int numRows() const;
 
-    void printMat(const std::string& name) const;
+    int numCols() const;
+
+    int stride() const;
+
+    void printMat(const char* name) const;
 
 private:
-    std::vector<Row> m_rows;
+    int m_rows;
+    int m_cols;
+    int m_stride;
+    double* m_data;
+    size_t m_capacity;
+    // result buffer of multiply() and transpose()
+    double* m_scratch;
+    size_t m_scratchCapacity;
+
+    static int strideOf(int cols);
+
+    static double* allocate(size_t n);
+
+    void reserveScratch(size_t n);
+
+    void swapScratch(int rows, int cols);
 };
 
 //
@@ -48,4 +81,3 @@ Matrix operator-(const Matrix& s1, const Matrix& s2);
 
 Matrix operator*(const Matrix& s1, const Matrix& s2);
 
-
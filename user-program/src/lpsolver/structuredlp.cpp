@@ -0,0 +1,325 @@
+//
+// Created by kccai.
+//
+
+#include "../bandit/macro_util.h"
+#include "structuredlp.h"
+
+#include <algorithm>
+#include <cmath>
+
+using std::vector;
+
+namespace {
+
+const double LP_EPS = 1e-9;
+
+// bisection steps on the multiplier / the max-latency u
+const int LP_BISECTION_STEPS = 100;
+
+} // namespace
+
+// the row holds exactly the columns from..N-1, all equal to one
+bool StructuredLP::isOnesRow(const CSRMatrix& A, int row, int from) const
+{
+    const int b = A.rowBegin(row), e = A.rowEnd(row);
+    if (e-b!=A.numCols()-from) {
+        return false;
+    }
+    for (int k = b; k<e; ++k) {
+        if (A.col(k)!=from+(k-b) || A.value(k)!=1.0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// copy the columns from..N-1 of a row into m_w, false if a column before from is set
+bool StructuredLP::scatterRow(const CSRMatrix& A, int row, int from)
+{
+    m_w.assign(A.numCols()-from, 0.0);
+    for (int k = A.rowBegin(row); k<A.rowEnd(row); ++k) {
+        if (A.col(k)<from) {
+            return false;
+        }
+        m_w[A.col(k)-from] = A.value(k);
+    }
+    return true;
+}
+
+StructuredLP::Shape StructuredLP::detect(const CSRMatrix& A, const vector<double>& b, const vector<double>& c,
+        bool maximize)
+{
+    const int M = A.numRows();
+    const int N = A.numCols();
+    if (M<2 || N<1 || (int) c.size()!=N || (int) b.size()<M-1) {
+        return GENERAL;
+    }
+
+    // CAPPED: a_i * x_i <= b_i for every column, then 1'x = Fix
+    if (M-1==N && isOnesRow(A, M-1, 0)) {
+        bool capped = true;
+        m_diag.assign(N, 0.0);
+        for (int i = 0; i<N && capped; ++i) {
+            const int k = A.rowBegin(i), len = A.rowEnd(i)-k;
+            if (len==1 && A.col(k)==i && A.value(k)>=0) {
+                m_diag[i] = A.value(k);
+            }
+            else if (len!=0) {
+                capped = false;
+            }
+            capped = capped && b[i]>=0;
+        }
+        if (capped) {
+            return CAPPED;
+        }
+    }
+
+    // KNAPSACK: w'x <= B, then 1'x = Fix
+    if (M==2 && isOnesRow(A, 1, 0) && scatterRow(A, 0, 0)) {
+        return KNAPSACK;
+    }
+
+    // MINMAX: x = (u, x_1, ..., x_K), min u s.t. -u + r_i x_i <= 0, w'x <= B, 1'x = Fix
+    if (!maximize && N>=2 && M==N+1 && c[0]==1.0 && isOnesRow(A, M-1, 1)) {
+        const int K = N-1;
+        for (int j = 1; j<N; ++j) {
+            if (c[j]!=0) {
+                return GENERAL;
+            }
+        }
+        m_diag.assign(K, 0.0);
+        for (int i = 0; i<K; ++i) {
+            const int k = A.rowBegin(i), len = A.rowEnd(i)-k;
+            if (b[i]!=0 || len<1 || len>2 || A.col(k)!=0 || A.value(k)!=-1.0) {
+                return GENERAL;
+            }
+            if (len==2) {
+                if (A.col(k+1)!=i+1 || A.value(k+1)<0) {
+                    return GENERAL;
+                }
+                m_diag[i] = A.value(k+1);
+            }
+        }
+        if (scatterRow(A, K, 1)) {
+            return MINMAX;
+        }
+    }
+
+    return GENERAL;
+}
+
+bool StructuredLP::solve(Shape shape, const vector<double>& b, const vector<double>& c,
+        double Fix, bool maximize, vector<double>& result)
+{
+    switch (shape) {
+    case CAPPED:
+        result.assign(m_diag.size(), 0.0);
+        return solveCapped(b, c, Fix, maximize, result);
+    case KNAPSACK:
+        result.assign(m_w.size(), 0.0);
+        return solveKnapsack(b, c, Fix, maximize, result);
+    case MINMAX:
+        result.assign(m_w.size()+1, 0.0);
+        return solveMinMax(b, Fix, result);
+    default:
+        return false;
+    }
+}
+
+// order the first n indices by m_key, ties broken by the index
+void StructuredLP::sortByKey(size_t n, bool descending)
+{
+    m_order.resize(n);
+    for (size_t i = 0; i<n; ++i) {
+        m_order[i] = (int) i;
+    }
+    const vector<double>& key = m_key;
+    if (descending) {
+        std::sort(m_order.begin(), m_order.end(), [&key](int i, int j) {
+            return key[i]>key[j] || (key[i]==key[j] && i<j);
+        });
+    }
+    else {
+        std::sort(m_order.begin(), m_order.end(), [&key](int i, int j) {
+            return key[i]<key[j] || (key[i]==key[j] && i<j);
+        });
+    }
+}
+
+// fill Fix units along m_order, each column up to its cap
+void StructuredLP::fillGreedy(size_t n, double Fix, const vector<double>& cap, vector<double>& x, size_t offset)
+{
+    double remaining = Fix;
+    for (size_t k = 0; k<n; ++k) {
+        const int i = m_order[k];
+        const double v = std::max(0.0, std::min(cap[i], remaining));
+        x[offset+i] = v;
+        remaining -= v;
+    }
+}
+
+bool StructuredLP::solveCapped(const vector<double>& b, const vector<double>& c,
+        double Fix, bool maximize, vector<double>& x)
+{
+    const size_t N = m_diag.size();
+    m_cap.resize(N);
+    double capSum = 0;
+    for (size_t i = 0; i<N; ++i) {
+        const double a = m_diag[i];
+        m_cap[i] = a>0 ? std::min(1.0, b[i]/a) : 1.0;
+        capSum += m_cap[i];
+    }
+    if (Fix<-LP_EPS || capSum<Fix-LP_EPS) {
+        return false;
+    }
+    m_key.assign(c.begin(), c.end());
+    sortByKey(N, maximize);
+    fillGreedy(N, Fix, m_cap, x, 0);
+    return true;
+}
+
+// Maximize (c - lambda*w)'x s.t. 1'x = Fix, 0 <= x <= 1; returns w'x.
+// Among ties the lighter column is preferred so w'x is the smallest one.
+double StructuredLP::fillLagrangian(const vector<double>& c, double lambda, double Fix, vector<double>& x)
+{
+    const size_t N = m_w.size();
+    const vector<double>& w = m_w;
+    m_key.resize(N);
+    m_order.resize(N);
+    for (size_t j = 0; j<N; ++j) {
+        m_key[j] = c[j]-lambda*w[j];
+        m_order[j] = (int) j;
+    }
+    const vector<double>& key = m_key;
+    const size_t whole = std::min(N, (size_t) std::floor(Fix+LP_EPS));
+    auto better = [&key, &w](int i, int j) {
+        return key[i]>key[j] || (key[i]==key[j] && (w[i]<w[j] || (w[i]==w[j] && i<j)));
+    };
+    if (whole<N) {
+        std::nth_element(m_order.begin(), m_order.begin()+whole, m_order.end(), better);
+    }
+    std::fill(x.begin(), x.end(), 0.0);
+    double wx = 0;
+    for (size_t k = 0; k<whole; ++k) {
+        x[m_order[k]] = 1.0;
+        wx += w[m_order[k]];
+    }
+    if (whole<N && Fix-whole>LP_EPS) {
+        x[m_order[whole]] = Fix-whole;
+        wx += (Fix-whole)*w[m_order[whole]];
+    }
+    return wx;
+}
+
+bool StructuredLP::solveKnapsack(const vector<double>& b, const vector<double>& c,
+        double Fix, bool maximize, vector<double>& x)
+{
+    const size_t N = m_w.size();
+    const double B = b[0];
+    if (Fix<-LP_EPS || Fix>N+LP_EPS) {
+        return false;
+    }
+    // always maximize internally
+    vector<double>& cs = m_cap;
+    cs.resize(N);
+    for (size_t j = 0; j<N; ++j) {
+        cs[j] = maximize ? c[j] : -c[j];
+    }
+
+    // the knapsack row is slack
+    if (fillLagrangian(cs, 0.0, Fix, x)<=B+LP_EPS) {
+        return true;
+    }
+
+    // the lightest selection violates the row as well
+    m_zero.assign(N, 0.0);
+    if (fillLagrangian(m_zero, 1.0, Fix, x)>B+LP_EPS) {
+        return false;
+    }
+
+    // bracket the multiplier: w'x(lambda) is non-increasing in lambda
+    double lo = 0.0, hi = 1.0;
+    for (int k = 0; k<LP_BISECTION_STEPS && fillLagrangian(cs, hi, Fix, x)>B; ++k) {
+        lo = hi;
+        hi *= 2;
+    }
+    for (int k = 0; k<LP_BISECTION_STEPS && hi-lo>1e-15*hi; ++k) {
+        const double mid = 0.5*(lo+hi);
+        if (fillLagrangian(cs, mid, Fix, x)>B) {
+            lo = mid;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    // both neighbours of the breakpoint are optimal, mix them to make w'x = B
+    m_xlo.resize(N);
+    const double wlo = fillLagrangian(cs, lo, Fix, m_xlo);
+    const double whi = fillLagrangian(cs, hi, Fix, x);
+    if (wlo-whi>LP_EPS) {
+        const double theta = std::min(1.0, std::max(0.0, (B-whi)/(wlo-whi)));
+        for (size_t j = 0; j<N; ++j) {
+            x[j] = theta*m_xlo[j]+(1-theta)*x[j];
+        }
+    }
+    return true;
+}
+
+bool StructuredLP::solveMinMax(const vector<double>& b, double Fix, vector<double>& x)
+{
+    const size_t K = m_w.size();
+    const vector<double>& w = m_w;
+    const double B = b[K];
+    if (Fix<-LP_EPS || Fix>K+LP_EPS) {
+        return false;
+    }
+
+    // the lightest columns are filled first, whatever u is
+    m_key.resize(K);
+    for (size_t j = 0; j<K; ++j) {
+        m_key[j] = w[j];
+    }
+    sortByKey(K, false);
+    m_cap.resize(K);
+
+    // is there an x with r_i x_i <= u, w'x <= B and 1'x = Fix?
+    auto feasible = [&](double u) {
+        double capSum = 0;
+        for (size_t i = 0; i<K; ++i) {
+            const double r = m_diag[i];
+            m_cap[i] = r>u ? u/r : 1.0;
+            capSum += m_cap[i];
+        }
+        if (capSum<Fix-LP_EPS) {
+            return false;
+        }
+        fillGreedy(K, Fix, m_cap, x, 1);
+        double wx = 0;
+        for (size_t j = 0; j<K; ++j) {
+            wx += w[j]*x[j+1];
+        }
+        return wx<=B+LP_EPS;
+    };
+
+    if (!feasible(1.0)) {
+        return false;
+    }
+    double lo = 0.0, hi = 1.0;
+    if (feasible(0.0)) {
+        hi = 0.0;
+    }
+    for (int k = 0; k<LP_BISECTION_STEPS && hi-lo>1e-15; ++k) {
+        const double mid = 0.5*(lo+hi);
+        if (feasible(mid)) {
+            hi = mid;
+        }
+        else {
+            lo = mid;
+        }
+    }
+    feasible(hi);
+    x[0] = hi;
+    return true;
+}
@@ -0,0 +1,69 @@
+//
+// Created by kccai.
+//
+
+#pragma once
+
+#include "csrmatrix.h"
+
+#include <vector>
+
+// Closed-form solvers for the LP shapes built by the ConMPTS policies.
+// All shapes share the LPSolver conventions: the first M-1 rows are
+// "<= b" rows, the last row is the equality "sum = Fix", and every
+// column is bounded in [0, 1].
+//
+//  CAPPED   : rows 0..N-1 are diagonal caps a_i*x_i <= b_i (latency),
+//             solved by sorting on c and filling, O(N log N).
+//  KNAPSACK : a single dense row w'x <= B (loss), solved by bisection on
+//             the Lagrange multiplier of that row, O(N) per step.
+//  MINMAX   : min u s.t. r_i*x_i - u <= 0, w'x <= B (bandwidth), solved
+//             by bisection on u, O(N) per step.
+//
+// detect() only walks the non-zero pattern and keeps the coefficients
+// that solve() needs.
+class StructuredLP {
+public:
+    enum Shape {
+        GENERAL,
+        CAPPED,
+        KNAPSACK,
+        MINMAX
+    };
+
+    Shape detect(const CSRMatrix& A, const std::vector<double>& b, const std::vector<double>& c, bool maximize);
+
+    // solves the problem last passed to detect(), false if it is infeasible
+    bool solve(Shape shape, const std::vector<double>& b, const std::vector<double>& c,
+            double Fix, bool maximize, std::vector<double>& result);
+
+private:
+    // diagonal caps a_i (CAPPED) or the latencies r_i (MINMAX)
+    std::vector<double> m_diag;
+    // the dense knapsack row (KNAPSACK, MINMAX)
+    std::vector<double> m_w;
+
+    std::vector<int> m_order;
+    std::vector<double> m_key;
+    std::vector<double> m_cap;
+    std::vector<double> m_xlo;
+    std::vector<double> m_zero;
+
+    bool isOnesRow(const CSRMatrix& A, int row, int from) const;
+
+    bool scatterRow(const CSRMatrix& A, int row, int from);
+
+    bool solveCapped(const std::vector<double>& b, const std::vector<double>& c,
+            double Fix, bool maximize, std::vector<double>& x);
+
+    bool solveKnapsack(const std::vector<double>& b, const std::vector<double>& c,
+            double Fix, bool maximize, std::vector<double>& x);
+
+    bool solveMinMax(const std::vector<double>& b, double Fix, std::vector<double>& x);
+
+    void sortByKey(size_t n, bool descending);
+
+    void fillGreedy(size_t n, double Fix, const std::vector<double>& cap, std::vector<double>& x, size_t offset);
+
+    double fillLagrangian(const std::vector<double>& c, double lambda, double Fix, std::vector<double>& x);
+};
@@ -18,21 +18,43 @@ int main(int argc, char* argv[])
     cmd.add<uint>("rounds", 'T', "number of rounds in a simulation", false, 10000);
     cmd.add<string>("file", 'f', "filename for parameters", false, "./pathdata/paraFile.txt");
     cmd.add<string>("output", 'o', "output filename", false, "pathLog.txt");
-    cmd.add<double>("threshold", 'h', "threshold for ConMPTSLatency", false, 0.4);
-    // Use the damping factor with care.
-    // The larger the factor the more forgetful the algorithm,
-    // but the more unstable estimation of the algorithm.
-    cmd.add<uint>("Delta", 'D', "Delta_t: interval for the simulator (us)", false, 100);
+    // several policies run side by side on the same paths, e.g.
+    // "conmpts-latency,mpts:posterior=window,klucb:tolerance=0"
+    cmd.add<string>("policy", '\0', "policies: name[:key=value...][,...] with name < "+PolicyFactory::names()+" >",
+            false, "conmpts-latency");
+    cmd.add<double>("threshold", 'h', "threshold of the constrained policies", false, 0.4);
+    // a kernel round decides when the kernel publishes new samples
+    cmd.add<uint>("Delta", 'D', "Delta_t: longest wait of a kernel round for new samples (us)", false, 1000000);
     // this is to test the flow completion time, if forever, then no logging
     // the program terminates if there is no measurement.
     cmd.add<bool>("Forever", 'F', "Forever running until the end", false, false);
-    cmd.add<double>("damping", 'd', "damping factor for ConMPTSLatency", false, 0.01);
+    // How the posteriors forget for paths that drift: discounted weighs an
+    // outcome of age a rounds (1-damping)^a, window keeps the last --window
+    // rounds. The more forgetful, the more unstable the estimation.
+    cmd.add<string>("posterior", '\0', "posterior: < stationary | discounted | window >", false, "stationary",
+            cmdline::oneof<string>("stationary", "discounted", "window"));
+    cmd.add<double>("damping", 'd', "damping factor of the discounted posterior", false, 0.01);
+    cmd.add<uint>("window", 'w', "rounds in the window posterior", false, 1000);
     cmd.add<int>("seed", 's', "random number seed", false, -1);
+    // the results only depend on the seed, not on the number of threads
+    cmd.add<uint>("threads", 'j', "threads for the simulations, 0 for all cores", false, 1);
+    // the round log is written by a background thread, the control loop never waits on it
+    cmd.add<int>("verbose", 'v', "round log: 0 quiet, 1 selected paths, 2 and kernel measurements", false, 0,
+            cmdline::range(0, 2));
+    cmd.add<string>("logfile", 'L', "round log file, '-' for stdout", false, "-");
+    // constant memory, also in the forever mode; averaged offline by olms-logavg
+    cmd.add<string>("stream", 'S', "stream every round to this binary file instead of the output file", false, "");
+    // replays the kernel measurements at full speed, without the module
+    cmd.add<string>("trace", 't', "replay the paths of this trace, recorded with --record", false, "");
 #ifdef OLMS_KERNEL
     cmd.add<uint>("P", 'P', "Total P paths", true, 2);
-    cmd.add<string>("pathtype", 'p', "Path type: < bernoulli | kernel >", true, "bernoulli");
+    cmd.add<string>("pathtype", 'p', "Path type: < bernoulli | kernel | replay >", true, "bernoulli");
     cmd.add<uint>("maxrtt", 'r', "The upper bound of RTprop (ms)", false, 100);
     cmd.add<uint>("maxbtlbw", 'b', "The uppper bound of BtlBw (Mbit per second)", false, 100);
+    cmd.add<string>("record", 'R', "record the kernel measurements of every round to this trace", false, "");
+    // the kernel splits the data over the paths by the LP solution of the
+    // ConMPTS policies instead of sending on the selected paths only
+    cmd.add<bool>("split", '\0', "split the data by the selection vector of the policy", false, false);
 #endif
     cmd.parse_check(argc, argv);
     const uint n = cmd.get<uint>("times");
@@ -40,14 +62,27 @@ int main(int argc, char* argv[])
     const uint T = cmd.get<uint>("rounds");
     const string parasFile = cmd.get<string>("file");
     const string outputFile = cmd.get<string>("output");
+    const string policySpecs = cmd.get<string>("policy");
     const double threshold = cmd.get<double>("threshold");
     const uint Delta_t = cmd.get<uint>("Delta");
     const bool isForever = cmd.get<bool>("Forever");
-    const double damping_factor = cmd.get<double>("damping");
+    const PosteriorParams posterior(posteriorModeFromString(cmd.get<string>("posterior")),
+            1-cmd.get<double>("damping"), cmd.get<uint>("window"));
     int rngSeed = cmd.get<int>("seed");
+    const int verbosity = cmd.get<int>("verbose");
+    const string roundLogFile = cmd.get<string>("logfile");
+    const string streamFile = cmd.get<string>("stream");
+    const string traceFile = cmd.get<string>("trace");
+    uint threads = cmd.get<uint>("threads");
+    uint32_t seed = std::time(0);
     if (rngSeed!=-1) {
         cout << "rngSeed=" << rngSeed << endl;
-        randomEngine = std::mt19937(rngSeed);
+        seed = rngSeed;
+    }
+    if (verbosity>LOG_QUIET && threads!=1) {
+        // the round log has a single producer
+        cerr << "--verbose runs the simulations on one thread" << endl;
+        threads = 1;
     }
 #ifdef OLMS_KERNEL
     const uint num_paths = cmd.get<uint>("P");
@@ -56,9 +91,14 @@ int main(int argc, char* argv[])
     const uint max_rtt = (cmd.get<uint>("maxrtt")*1000);     // change to scale the srtt
     // In the kernel: bw is scaled down to Bytes per second
     const uint max_btlbw = (cmd.get<uint>("maxbtlbw")*1000000) >> 3; // change to bytes
-    kcmpts.set_num_paths(num_paths);
-    kcmpts.set_max_rtt(max_rtt);
-    kcmpts.set_max_btlbw(max_btlbw);
+    kolms.set_num_paths(num_paths);
+    kolms.set_max_rtt(max_rtt);
+    kolms.set_max_btlbw(max_btlbw);
+    kolms.set_split(cmd.get<bool>("split"));
+    const string recordFile = cmd.get<string>("record");
+    if (!recordFile.empty()) {
+        kolms.startRecording(recordFile);
+    }
 #endif
     vector<PathPtr> paths;
     vector<PolicyPtr> policies;
@@ -70,11 +110,23 @@ int main(int argc, char* argv[])
     else if (pathType.compare("kernel")==0) {
         initKernelPaths(paths, M, num_paths);
     }
+    else if (pathType.compare("replay")==0) {
+        if (traceFile.empty()) {
+            cerr << "--pathtype replay needs --trace" << endl;
+            return EXIT_FAILURE;
+        }
+        initReplayPaths(paths, traceFile);
+    }
 #else
-    initPaths(paths, parasFile);
+    if (!traceFile.empty()) {
+        initReplayPaths(paths, traceFile);
+    }
+    else {
+        initPaths(paths, parasFile);
+    }
 #endif
     cout << "Initpath finished..." << endl;
-    initPolicies(policies, paths.size(), threshold, damping_factor);
+    initPolicies(policies, paths.size(), policySpecs, PolicyDefaults(threshold, posterior));
 #if DEBUG_mode
     for (auto p : policies) {
         std::cout << "main.cpp: " << p->info() << "" << std::endl;
@@ -82,7 +134,12 @@ int main(int argc, char* argv[])
 #endif
     cout << "Initpolicies finished..." << endl;
 //    bool recommendSinglePath = false;
-    startSimulation(n, T, M, threshold, paths, policies, outputFile, Delta_t, isForever);
+    olmsLog.start(verbosity, roundLogFile);
+    startSimulation(n, T, M, threshold, paths, policies, outputFile, Delta_t, isForever, streamFile, seed, threads);
+    olmsLog.stop();
+#ifdef OLMS_KERNEL
+    kolms.stopRecording();
+#endif
 
     return 0;
 }
@@ -9,19 +9,31 @@ enum PathType {
     FIXVALUE,
     BERNOULLI,
     NORMAL,
-    KERNEL
+    KERNEL,
+    REPLAY
 };
 
 // Path base class
 class Path {
 public:
+    // the clones are owned and deleted through base pointers
+    virtual ~Path() {}
+
     //base functions should not be called
     virtual Metric getMeasurement() = 0;
 
+    // called once at the start of round t, before any policy measures
+    virtual void beginRound(uint t)
+    {
+    }
+
     virtual Metric getMeanMetric() = 0;
 
     virtual std::string printInfo() = 0;
 
     virtual PathType getType() = 0;
+
+    // a copy with the same parameters, for another simulation run
+    virtual Path* clone() const = 0;
 };
 } //namespace
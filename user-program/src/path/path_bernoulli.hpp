@@ -5,13 +5,12 @@
 
 namespace bandit {
 
-class BernoulliPath: public Path {
+class BernoulliPath final: public Path {
     const Metric meanMetric;
-    std::uniform_real_distribution<double> unif;
 
 public:
     explicit BernoulliPath(Metric average)
-            :meanMetric(Metric{average.r, average.b, average.l}), unif(0.0, 1.0)
+            :meanMetric(Metric{average.r, average.b, average.l})
     {
     }
 
@@ -22,9 +21,11 @@ public:
 
     Metric getMeasurement() override
     {
-        double rand_r = unif(randomEngine);
-        double rand_b = unif(randomEngine);
-        double rand_l = unif(randomEngine);
+        double u[3];
+        randomEngine.fillUniform(u, 3);
+        double rand_r = u[0];
+        double rand_b = u[1];
+        double rand_l = u[2];
 
         // tr, tb, tl, are either 1.0 or 0.0
         double tr = bernoulliTrial(rand_r, meanMetric.r);
@@ -44,6 +45,11 @@ public:
         return str;
     }
 
+    Path* clone() const override
+    {
+        return new BernoulliPath(*this);
+    }
+
     PathType getType() override
     {
         return PathType::BERNOULLI;
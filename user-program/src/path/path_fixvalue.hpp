@@ -10,7 +10,7 @@
 
 namespace bandit {
 
-class FixValuePath: public Path {
+class FixValuePath final: public Path {
     const Metric meanMetric;
 
 public:
@@ -39,6 +39,11 @@ public:
         return str;
     }
 
+    Path* clone() const override
+    {
+        return new FixValuePath(*this);
+    }
+
     PathType getType() override
     {
         return PathType::FIXVALUE;
@@ -6,15 +6,13 @@
 
 namespace bandit {
 
-class KernelPath: public Path {
+class KernelPath final: public Path {
     const Metric meanMetric;
-    std::uniform_real_distribution<double> unif;
     int path_idx;
 
 public:
     explicit KernelPath(Metric average, int idx)
-            :meanMetric(Metric{average.r, average.b, average.l}), unif(0.0, 1.0),
-             path_idx(idx)
+            :meanMetric(Metric{average.r, average.b, average.l}), path_idx(idx)
     {
     }
 
@@ -22,17 +20,11 @@ public:
 
     Metric getMeasurement() override
     {
-        // double rand_r = unif(randomEngine);
-        // double rand_b = unif(randomEngine);
-        // double rand_l = unif(randomEngine);
-
         // tr, tb, tl, are either 1.0 or 0.0
         double tr = kolms.rvec[path_idx];
         double tb = kolms.bvec[path_idx];
         double tl = kolms.lvec[path_idx];
 
-        // double tb = bernoulliTrial(rand_b, meanMetric.b);
-        // double tl = bernoulliTrial(rand_l, meanMetric.l);
         //  if (1) {
         //      std::cout << "play[" << path_idx << "]: " << tr << std::endl;
         //      std::cout << std::endl;
@@ -50,6 +42,8 @@ public:
     }
 
     PathType getType() override { return PathType::KERNEL; }
+
+    Path* clone() const override { return new KernelPath(*this); }
 };
 
 } // namespace bandit
@@ -11,12 +11,11 @@ namespace bandit {
 
 typedef std::tuple<double,double> Norm;
 
-class NormalPath: public Path {
+class NormalPath final: public Path {
     Norm r;
     Norm b;
     Norm l;
     const Metric meanMetric;
-    std::uniform_real_distribution<double> unif;
 public:
     NormalPath(Norm r_, Norm b_, Norm l_)
             :r(r_), b(b_), l(l_)
@@ -44,6 +43,11 @@ public:
 
     }
 
+    Path* clone() const override
+    {
+        return new NormalPath(*this);
+    }
+
     PathType getType() override
     {
 
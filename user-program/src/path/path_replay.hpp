@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../bandit/macro_util.h"
+#include "../bandit/trace.hpp"
+#include "path.hpp"
+
+namespace bandit {
+
+// A path that replays column path_idx of a recorded trace: round t
+// measures row t of the trace. No device and no sleeping, the rounds run
+// as fast as the policies decide.
+class ReplayPath final: public Path {
+    std::shared_ptr<const TraceReader> trace;
+    int path_idx;
+    Metric meanMetric;
+    // {r, b, l} of the current round
+    const float* current;
+
+public:
+    ReplayPath(const std::shared_ptr<const TraceReader>& trace, int idx)
+            :trace(trace), path_idx(idx), meanMetric(trace->mean(idx)), current(trace->row(0)+3*idx)
+    {
+    }
+
+    void beginRound(uint t) override
+    {
+        current = trace->row(t)+3*path_idx;
+    }
+
+    Metric getMeasurement() override
+    {
+        return Metric(current[0], current[1], current[2]);
+    }
+
+    Metric getMeanMetric() override { return meanMetric; }
+
+    std::string printInfo() override
+    {
+        std::string str = "\t"+dtos(meanMetric.r)+"\t"+
+                dtos(meanMetric.b)+"\t"+dtos(meanMetric.l);
+
+        return str;
+    }
+
+    PathType getType() override { return PathType::REPLAY; }
+
+    Path* clone() const override { return new ReplayPath(*this); }
+};
+
+} // namespace bandit
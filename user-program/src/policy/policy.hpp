@@ -2,6 +2,8 @@
 
 #include "../bandit/bandit_util.hpp"
 #include "../bandit/distributions.hpp"
+#include "../bandit/pathset.hpp"
+#include "../bandit/posterior.hpp"
 
 namespace bandit {
 
@@ -15,17 +17,54 @@ enum PolicyType {
     RANDOM
 };
 
+// Buffers of one policy that are reused from round to round, so that a
+// round in steady state does not allocate.
+struct ScratchArena {
+    // posterior samples
+    std::vector<double> sample1, sample2;
+    // LP solution or selection probabilities
+    std::vector<double> x;
+    // LP right-hand side and objective
+    std::vector<double> b, c;
+    // the order of topIndices
+    std::vector<uint> ranked;
+    std::vector<uint> indices;
+    std::vector<bool> flags;
+    // uniforms drawn in one batch
+    std::vector<double> uniforms;
+    RoundingScratch rounding;
+    BetaScratch beta;
+};
+
+// The selected paths are written into a vector owned by the caller. The
+// update gets them back as a PathSet, with the measurements indexed by
+// path id.
 class Policy {
 public:
-    virtual std::vector<uint> selectNextPaths(uint) = 0;
+    // the clones are owned and deleted through base pointers
+    virtual ~Policy() {}
+
+    virtual void selectNextPaths(uint M, std::vector<uint>& paths) = 0;
+
+    virtual void updateState(const PathSet<>& paths, const MetricBlock<>& measurements) = 0;
 
-    virtual void updateState(std::vector<uint>, std::vector<Metric>) = 0;
+    // policies without a discounted update learn as in updateState
+    virtual void updateStateDamped(const PathSet<>& paths, const MetricBlock<>& measurements)
+    {
+        updateState(paths, measurements);
+    }
 
-    virtual void updateStateDamped(std::vector<uint>, std::vector<Metric>) = 0;
+    virtual void selectNextPathsAvg(uint M, std::vector<uint>& paths) = 0;
 
-    virtual std::vector<uint> selectNextPathsAvg(uint M) = 0;
+    virtual void updateStateAvg(const PathSet<>& paths, const MetricBlock<>& measurements) = 0;
 
-    virtual void updateStateAvg(std::vector<uint>, std::vector<Metric>) = 0;
+    // The fractional selection of the last selectNextPaths, i.e. the
+    // probabilities of the K paths that the M selected paths were rounded
+    // from, or NULL if the policy has none. Valid until the next selection.
+    virtual const std::vector<double>* selectionWeights()
+    {
+        return NULL;
+    }
 
     virtual std::string name() = 0;
 
@@ -33,6 +72,26 @@ public:
 
     virtual PolicyType getType() = 0;
 
+    // a copy in the current state, for another simulation run
+    virtual Policy* clone() const = 0;
+
+    // the constrained policies know the expected reward of the best
+    // selection for the mean rtt r and bandwidth b
+    virtual bool hasOracle()
+    {
+        return false;
+    }
+
+    virtual double computeOracle(const std::vector<double>& r, const std::vector<double>& b, uint M,
+            double threshold)
+    {
+        return 0;
+    }
+
+protected:
+    ScratchArena scratch;
 };
 
+typedef std::shared_ptr<Policy> PolicyPtr;
+
 } //namespace
@@ -9,51 +9,51 @@ namespace bandit {
 //Constrained Multi-Path Thompson sampling (binary reward)
 // for the bandwidth aware multi-path selection
 
-class ConMPTSBandwidth: public Policy {
+class ConMPTSBandwidth final: public Policy {
     const uint K;
     double threshold;
-    std::vector<double> sb, fb; //s: success; f: fail
-    std::vector<double> sr, fr; //s: success; f: fail
-    std::uniform_real_distribution<double> unif;
+    // posteriors of the Bernoulli trials of the bandwidth and the rtt
+    BetaPosterior bw, rtt;
+    // kept across rounds, only the sampled coefficients change
+    LPSolver lpSolver;
+    CSRMatrix lpA;
+    // the last selection was rounded from the LP solution in scratch.x
+    bool fromLP;
 
 public:
-    ConMPTSBandwidth(uint K, double threshold, double s = 1, double f = 1)
-            :K(K), threshold(threshold), unif(0.0, 1.0)
+    ConMPTSBandwidth(uint K, double threshold, double s = 1, double f = 1,
+            const PosteriorParams& posteriorParams = PosteriorParams())
+            :K(K), threshold(threshold),
+             bw(K, s, f, posteriorParams), rtt(K, s, f, posteriorParams), fromLP(false)
     {
-        for (uint i = 0; i<K; ++i) {
-            // for bandwidth
-            sb.push_back(s);
-            fb.push_back(f);
-            // for rtt
-            sr.push_back(s);
-            fr.push_back(f);
-        }
     }
 
-    std::vector<uint> selectNextPaths(uint M) override
+    void selectNextPaths(uint M, std::vector<uint>& paths) override
     {
         // Posterior estimate
-        std::vector<double> hatb(K, 0.0);
-        std::vector<double> hatr(K, 0.0);
+        std::vector<double>& hatb = scratch.sample1;
+        std::vector<double>& hatr = scratch.sample2;
+        hatb.resize(K);
+        hatr.resize(K);
         // vector lp_x: the size is K+1;
-        std::vector<double> lp_x;
+        std::vector<double>& lp_x = scratch.x;
 
         // Get the selection vector
-        for (uint i = 0; i<K; ++i) {
-            hatb[i] = beta_distribution<double>(sb[i], fb[i])(randomEngine);
-            hatr[i] = beta_distribution<double>(sr[i], fr[i])(randomEngine);
-        }
+        sampleBeta(bw.alphas(), bw.betas(), hatb, randomEngine, scratch.beta);
+        sampleBeta(rtt.alphas(), rtt.betas(), hatr, randomEngine, scratch.beta);
         // Call the LP.
         LPSolver::LPStatus status = solveConTSLP(hatr, hatb, M, threshold, lp_x);
-        if (status==LPSolver::FEASIBLE) {
-            // Selection vector vt: the size is K;
-            std::vector<double> vt(lp_x.begin()+1, lp_x.end());
+        fromLP = status==LPSolver::FEASIBLE;
+        if (fromLP) {
+            // Selection vector vt: the size is K, drop u in front
+            std::vector<double>& vt = lp_x;
+            vt.erase(vt.begin());
             printVec("vt in SelectNextPath: ", vt);
             // Select M paths with vector vt
-            return dependentRounding(M, vt);
+            dependentRounding(M, vt, scratch.rounding, paths);
         }
         else {
-            return vectorMinIndices(hatr, M);
+            vectorMinIndices(hatr, M, scratch.ranked, paths);
         }
     }
 
@@ -88,43 +88,47 @@ public:
     {
         /*x = (u, x1, ..., xk)*/
         /* construct the standard Matrix A */
-        Matrix lp_A(K+2, K+1);
+        CSRMatrix& lp_A = lpA;
+        lp_A.clear(K+1);
         // Part 1. for the -u + r_i * v_i <= 0
         // first K rows
         for (int i = 0; i<K; ++i) {
-            lp_A[i][0] = -1.0;
+            lp_A.push(0, -1.0);
             // lp_A is the r vector
-            lp_A[i][i+1] = hatr[i];
+            lp_A.push(i+1, hatr[i]);
+            lp_A.nextRow();
         }
         // Part 2. for the b'*v <= C_b
         // the (K+1)-th row
-        lp_A[K][0] = 0;
         for (int i = 1; i<K+1; ++i) {
-            lp_A[K][i] = hatb[i];
+            lp_A.push(i, hatb[i-1]);
         }
+        lp_A.nextRow();
         // Part 3. Init the (K+2)-th row (equality constraint)
-        lp_A[K+1][0] = 0.0;
         for (int j = 1; j<K+1; ++j) {
-            lp_A[K][j] = 1;
+            lp_A.push(j, 1);
         }
+        lp_A.nextRow();
         /* Construct the standard vector lp_b (with last equal constraint) */
-        std::vector<double> lp_b(K+1, 0.0); // for part 1;
+        std::vector<double>& lp_b = scratch.b;
+        lp_b.assign(K+1, 0.0); // for part 1;
         lp_b[K] = Cb; // for Part 2;
         // Mpath is for lp_fix for Part 3;
 
         /* Construct the standard vector lp_c */
-        std::vector<double> lp_c(K+1, 0.0);
+        std::vector<double>& lp_c = scratch.c;
+        lp_c.assign(K+1, 0.0);
         lp_c[0] = 1.0;
 
         lp_A.printMat("Bandwidth_lp_A:");
         printVec("lp_b", lp_b);
         printVec("lp_c", lp_c);
         printVar("lp_fix", Mpath);
-        LPSolver Solver(lp_A, lp_b, lp_c, Mpath);
+        lpSolver.update(lp_A, lp_b, lp_c, Mpath);
         // Minimize the maximum rtt
-        Solver.setMinimization();
+        lpSolver.setMinimization();
         // Solving the linear program
-        LPSolver::LPStatus status = Solver.solve(lp_x);
+        LPSolver::LPStatus status = lpSolver.solve(lp_x);
 
 //        if (status==LPSolver::ERROR) {
 //            // Uniform random
@@ -137,34 +141,44 @@ public:
         return status;
     }
 
-    void updateState(std::vector<uint> selectedPaths, std::vector<Metric> selectedPathMeasurements) override
+    void updateState(const PathSet<>& selectedPaths, const MetricBlock<>& selectedPathMeasurements) override
     {
-        for (uint i = 0; i<selectedPaths.size(); ++i) {
-            uint k = selectedPaths[i];
-            Metric measurement = selectedPathMeasurements[i];
-
-            double rand_b = unif(randomEngine);
-            double rand_r = unif(randomEngine);
+        std::vector<double>& u = scratch.uniforms;
+        u.resize(2*selectedPaths.size());
+        randomEngine.fillUniform(u);
+        bw.nextRound();
+        rtt.nextRound();
+        uint i = 0;
+        for (uint k : selectedPaths) {
+            const Metric& measurement = selectedPathMeasurements[k];
+
+            double rand_b = u[2*i];
+            double rand_r = u[2*i+1];
 
             double tb = bernoulliTrial(rand_b, measurement.b);
             double tr = bernoulliTrial(rand_r, measurement.r);
 
-            if (tb>0.5) { sb[k] += 1; } else { fb[k] += 1; }
-            if (tr>0.5) { sr[k] += 1; } else { fr[k] += 1; }
-
+            bw.observe(k, tb>0.5);
+            rtt.observe(k, tr>0.5);
+            ++i;
         }
     }
 
-    std::vector<uint> selectNextPathsAvg(uint M) override
+    void selectNextPathsAvg(uint M, std::vector<uint>& paths) override
     {
 
     }
 
-    void updateStateAvg(std::vector<uint> selectedPaths, std::vector<Metric> selectedPathMeasurements) override
+    void updateStateAvg(const PathSet<>& selectedPaths, const MetricBlock<>& selectedPathMeasurements) override
     {
 
     }
 
+    const std::vector<double>* selectionWeights() override
+    {
+        return fromLP ? &scratch.x : NULL;
+    }
+
     std::string name() override
     {
         return "ConMPTSBandwidth_aware";
@@ -182,6 +196,22 @@ public:
     {
         return PolicyType::CONMPTS_Bandwidth;
     }
+
+    Policy* clone() const override
+    {
+        return new ConMPTSBandwidth(*this);
+    }
+
+    bool hasOracle() override
+    {
+        return true;
+    }
+
+    double computeOracle(const std::vector<double>& r, const std::vector<double>& b, uint M,
+            double threshold) override
+    {
+        return computeOracleBandwidth(r, b, M, threshold);
+    }
 };
 
 } //namespace
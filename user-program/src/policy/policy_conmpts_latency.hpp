@@ -9,29 +9,28 @@ namespace bandit {
 //Constrained Multi-Path Thompson sampling (binary reward)
 // for the latency aware multi-path selection
 
-class ConMPTSLatency: public Policy {
+class ConMPTSLatency final: public Policy {
     const uint K;
     double threshold;
-    double damping_factor;
 
     std::vector<double> avgb;
     std::vector<double> avgr;
     std::vector<uint> selected_times;
-    std::vector<double> sb, fb; //s: success; f: fail
-    std::vector<double> sr, fr; //s: success; f: fail
-    std::uniform_real_distribution<double> unif;
+    // posteriors of the Bernoulli trials of the bandwidth and the rtt
+    BetaPosterior bw, rtt;
+    // kept across rounds, only the sampled coefficients change
+    LPSolver lpSolver;
+    CSRMatrix lpA;
+    // the last selection was rounded from the LP solution in scratch.x
+    bool fromLP;
 
 public:
-    ConMPTSLatency(uint K, double threshold, double damping_factor_, double s = 1, double f = 1)
-            :K(K), threshold(threshold), damping_factor(damping_factor_), unif(0.0, 1.0)
+    ConMPTSLatency(uint K, double threshold, double s = 1, double f = 1,
+            const PosteriorParams& posteriorParams = PosteriorParams())
+            :K(K), threshold(threshold),
+             bw(K, s, f, posteriorParams), rtt(K, s, f, posteriorParams), fromLP(false)
     {
         for (uint i = 0; i<K; ++i) {
-            // for bandwidth
-            sb.push_back(s);
-            fb.push_back(f);
-            // for rtt
-            sr.push_back(s);
-            fr.push_back(f);
             // average metric init with 0
             avgb.push_back(0.5);
             avgr.push_back(0.5);
@@ -39,37 +38,34 @@ public:
         }
     }
 
-    std::vector<uint> selectNextPaths(uint M) override
+    void selectNextPaths(uint M, std::vector<uint>& paths) override
     {
         // Posterior estimate
-        std::vector<double> hatb(K, 0.0);
-        std::vector<double> hatr(K, 0.0);
+        std::vector<double>& hatb = scratch.sample1;
+        std::vector<double>& hatr = scratch.sample2;
+        hatb.resize(K);
+        hatr.resize(K);
         // Selection vector
-        std::vector<double> vt(K, 0.0);
-        // Threshold vector
-        std::vector<double> vTh(K, threshold);
+        std::vector<double>& vt = scratch.x;
         // Get the selection vector
-        for (uint i = 0; i<K; ++i) {
-            hatb[i] = beta_distribution<double>(sb[i], fb[i])(randomEngine);
-            hatr[i] = beta_distribution<double>(sr[i], fr[i])(randomEngine);
-            // hatb[i] = sb[i]/(sb[i]+fb[i]);
-            // hatr[i] = sr[i]/(sr[i]+fr[i]);
-        }
+        sampleBeta(bw.alphas(), bw.betas(), hatb, randomEngine, scratch.beta);
+        sampleBeta(rtt.alphas(), rtt.betas(), hatr, randomEngine, scratch.beta);
 
         // printVecR("hatr", hatr);
 
         // Call the LP.
         LPSolver::LPStatus status = solveConTSLP(hatr, hatb, M, threshold, vt);
 
-        if (status==LPSolver::FEASIBLE) {
+        fromLP = status==LPSolver::FEASIBLE;
+        if (fromLP) {
             printVec("vt in SelectNextPath: ", vt);
             // Select M paths with vector vt
             // std::cout<< "Feasible "<<std::endl;
-            return dependentRounding(M, vt);
+            dependentRounding(M, vt, scratch.rounding, paths);
         }
         else {
             // std::cout<< "ERROR "<<std::endl;
-            return vectorMinIndices(hatr, M);
+            vectorMinIndices(hatr, M, scratch.ranked, paths);
         }
 
     }
@@ -113,18 +109,22 @@ public:
 //        }
 //        else {
 
-        // construct A
-        Matrix A(K+1, K);
+        // construct A: the diagonal r_i x_i <= Cr rows, 2K cells in total
+        CSRMatrix& A = lpA;
+        A.clear(K);
         for (int i = 0; i<K; ++i) {
-            A[i][i] = rtt[i];
+            A.push(i, rtt[i]);
+            A.nextRow();
         }
         // Init the last row
         for (int j = 0; j<K; ++j) {
-            A[K][j] = 1;
+            A.push(j, 1);
         }
+        A.nextRow();
 
         // Construct lp_b
-        const std::vector<double> lp_b(K, Cr);
+        std::vector<double>& lp_b = scratch.b;
+        lp_b.assign(K, Cr);
         // Construct lp_c
         const std::vector<double>& lp_c = bw;
 
@@ -132,9 +132,9 @@ public:
         printVec("lp_b", lp_b);
         printVec("lp_c", lp_c);
         printVar("lp_fix", Mpath);
-        LPSolver Solver(A, lp_b, lp_c, Mpath);
-        Solver.setMaximization();
-        LPSolver::LPStatus status = Solver.solve(lp_x);
+        lpSolver.update(A, lp_b, lp_c, Mpath);
+        lpSolver.setMaximization();
+        LPSolver::LPStatus status = lpSolver.solve(lp_x);
         printVec("lp_x", lp_x);
 //        if (status==LPSolver::ERROR) {
 //            // Uniform random
@@ -148,94 +148,57 @@ public:
 
     }
 
-    void updateState(std::vector<uint> selectedPaths, std::vector<Metric> selectedPathMeasurements) override
+    void updateState(const PathSet<>& selectedPaths, const MetricBlock<>& selectedPathMeasurements) override
     {
-        for (uint i = 0; i<selectedPaths.size(); ++i) {
-            uint k = selectedPaths[i];
-            Metric measurement = selectedPathMeasurements[i];
-
-            double rand_b = unif(randomEngine);
-            double rand_r = unif(randomEngine);
+        std::vector<double>& u = scratch.uniforms;
+        u.resize(2*selectedPaths.size());
+        randomEngine.fillUniform(u);
+        bw.nextRound();
+        rtt.nextRound();
+        uint i = 0;
+        for (uint k : selectedPaths) {
+            const Metric& measurement = selectedPathMeasurements[k];
+
+            double rand_b = u[2*i];
+            double rand_r = u[2*i+1];
 
             double tb = bernoulliTrial(rand_b, measurement.b);
             double tr = bernoulliTrial(rand_r, measurement.r);
 
-            if (tb>0.5) { sb[k] += 1; } else { fb[k] += 1; }
-            if (tr>0.5) { sr[k] += 1; } else { fr[k] += 1; }
-
-        }
-    }
-
-    void updateStateDamped(std::vector<uint> selectedPaths, std::vector<Metric> selectedPathMeasurements) override
-    {
-        double memory_factor = 1-damping_factor;
-        for (uint j = 0; j<K; ++j) {
-            for (uint i = 0; i<selectedPaths.size(); ++i) {
-                uint k = selectedPaths[i];
-                if (j==k) {
-                    Metric measurement = selectedPathMeasurements[i];
-                    double rand_b = unif(randomEngine);
-                    double rand_r = unif(randomEngine);
-                    double tb = bernoulliTrial(rand_b, measurement.b);
-                    double tr = bernoulliTrial(rand_r, measurement.r);
-
-                    if (tb>0.5) {
-                        sb[j] = memory_factor*(sb[j]+1);
-                        sb[j] = max(sb[j], 1.0);
-                    }
-                    else {
-                        fb[j] = memory_factor*(fb[j]+1);
-                        fb[j] = max(fb[j], 1.0);
-                    }
-                    if (tr>0.5) {
-                        sr[j] = memory_factor*(sr[j]+1);
-                        sr[j] = max(sr[j], 1.0);
-                    }
-                    else {
-                        fr[j] = memory_factor*(fr[j]+1);
-                        fr[j] = max(fr[j], 1.0);
-                    }
-                }
-                else { // also forget history of other paths
-                    sb[j] = max(memory_factor*sb[j], 1.0);
-                    fb[j] = max(memory_factor*fb[j], 1.0);
-                    sr[j] = max(memory_factor*sr[j], 1.0);
-                    fr[j] = max(memory_factor*fr[j], 1.0);
-                }
-            }
+            bw.observe(k, tb>0.5);
+            rtt.observe(k, tr>0.5);
+            ++i;
         }
     }
 
-    std::vector<uint> selectNextPathsAvg(uint M) override
+    void selectNextPathsAvg(uint M, std::vector<uint>& paths) override
     {
 
         // Selection vector
-        std::vector<double> vt(K, 0.0);
-        // Threshold vector
-        std::vector<double> vTh(K, threshold);
+        std::vector<double>& vt = scratch.x;
 
         printVecR("rtt-avg", avgr);
         // Get the selection vector and Call the LP with the average estimate.
         LPSolver::LPStatus status = solveConTSLP(avgr, avgb, M, threshold, vt);
 
-        if (status==LPSolver::FEASIBLE) {
+        fromLP = status==LPSolver::FEASIBLE;
+        if (fromLP) {
             printVec("vt in SelectNextPath: ", vt);
             // Select M paths with vector vt
             // std::cout<< "Feasible "<<std::endl;
-            return dependentRounding(M, vt);
+            dependentRounding(M, vt, scratch.rounding, paths);
         }
         else {
             // std::cout<< "ERROR "<<std::endl;
-            return vectorMinIndices(avgr, M);
+            vectorMinIndices(avgr, M, scratch.ranked, paths);
         }
     }
 
-    void updateStateAvg(std::vector<uint> selectedPaths, std::vector<Metric> selectedPathMeasurements) override
+    void updateStateAvg(const PathSet<>& selectedPaths, const MetricBlock<>& selectedPathMeasurements) override
     {
         printMsg("Latency-update-avg-start");
-        for (uint i = 0; i<selectedPaths.size(); ++i) {
-            uint k = selectedPaths[i];
-            Metric measurement = selectedPathMeasurements[i];
+        for (uint k : selectedPaths) {
+            const Metric& measurement = selectedPathMeasurements[k];
 
             uint k_times = selected_times[k];
             double k_avgb = avgb[k];
@@ -250,6 +213,11 @@ public:
         printMsg("Latency-update-avg-end");
     }
 
+    const std::vector<double>* selectionWeights() override
+    {
+        return fromLP ? &scratch.x : NULL;
+    }
+
     std::string name() override
     {
         return "ConMPTSLatency";
@@ -267,6 +235,22 @@ public:
     {
         return PolicyType::CONMPTS_Latency;
     }
+
+    Policy* clone() const override
+    {
+        return new ConMPTSLatency(*this);
+    }
+
+    bool hasOracle() override
+    {
+        return true;
+    }
+
+    double computeOracle(const std::vector<double>& r, const std::vector<double>& b, uint M,
+            double threshold) override
+    {
+        return computeOracleLatency(r, b, M, threshold);
+    }
 };
 
 } //namespace
@@ -9,51 +9,49 @@ namespace bandit {
 //Constrained Multi-Path Thompson sampling (binary reward)
 // for the loss aware multi-path selection
 
-class ConMPTSLoss: public Policy {
+class ConMPTSLoss final: public Policy {
     const uint K;
     double threshold;
-    std::vector<double> sb, fb; //s: success; f: fail
-    std::vector<double> sl, fl; //s: success; f: fail
-    std::uniform_real_distribution<double> unif;
+    // posteriors of the Bernoulli trials of the bandwidth and the loss rate
+    BetaPosterior bw, loss;
+    // kept across rounds, only the sampled coefficients change
+    LPSolver lpSolver;
+    CSRMatrix lpA;
+    // the last selection was rounded from the LP solution in scratch.x
+    bool fromLP;
 
 public:
-    ConMPTSLoss(uint K, double threshold, double s = 1, double f = 1)
-            :K(K), threshold(threshold), unif(0.0, 1.0)
+    ConMPTSLoss(uint K, double threshold, double s = 1, double f = 1,
+            const PosteriorParams& posteriorParams = PosteriorParams())
+            :K(K), threshold(threshold),
+             bw(K, s, f, posteriorParams), loss(K, s, f, posteriorParams), fromLP(false)
     {
-        for (uint i = 0; i<K; ++i) {
-            // for bandwidth
-            sb.push_back(s);
-            fb.push_back(f);
-            // for loss
-            sl.push_back(s);
-            fl.push_back(f);
-        }
     }
 
-    std::vector<uint> selectNextPaths(uint M) override
+    void selectNextPaths(uint M, std::vector<uint>& paths) override
     {
         // Posterior estimate
-        std::vector<double> hatb(K, 0.0);
-        std::vector<double> hatl(K, 0.0);
+        std::vector<double>& hatb = scratch.sample1;
+        std::vector<double>& hatl = scratch.sample2;
+        hatb.resize(K);
+        hatl.resize(K);
         // Selection vector
-        std::vector<double> vt(K, 0.0);
-        // Threshold vector
+        std::vector<double>& vt = scratch.x;
 
         // Get the selection vector
-        for (uint i = 0; i<K; ++i) {
-            hatb[i] = beta_distribution<double>(sb[i], fb[i])(randomEngine);
-            hatl[i] = beta_distribution<double>(sl[i], fl[i])(randomEngine);
-        }
+        sampleBeta(bw.alphas(), bw.betas(), hatb, randomEngine, scratch.beta);
+        sampleBeta(loss.alphas(), loss.betas(), hatl, randomEngine, scratch.beta);
         // Call the LP.
         LPSolver::LPStatus status = solveConTSLP(hatb, hatl, M, threshold, vt);
 
-        if (status==LPSolver::FEASIBLE) {
+        fromLP = status==LPSolver::FEASIBLE;
+        if (fromLP) {
             printVec("vt in SelectNextPath: ", vt);
             // Select M paths with vector vt
-            return dependentRounding(M, vt);
+            dependentRounding(M, vt, scratch.rounding, paths);
         }
         else {
-            return vectorMinIndices(hatl, M);
+            vectorMinIndices(hatl, M, scratch.ranked, paths);
         }
 
     }
@@ -88,19 +86,22 @@ public:
     {
         /*x = (u, x1, ..., xk)*/
         /* Construct lp_A*/
-        Matrix lp_A(2, K);
+        CSRMatrix& lp_A = lpA;
+        lp_A.clear(K);
 
         // Part 1. for the l'x <= Cl
         for (int i = 0; i<K; ++i) {
-            lp_A[0][i] = hatl[i];
+            lp_A.push(i, hatl[i]);
         }
+        lp_A.nextRow();
         // Part 2. for the 1'v = M
         for (int i = 0; i<K; ++i) {
-            lp_A[1][i] = 1;
+            lp_A.push(i, 1);
         }
+        lp_A.nextRow();
         /* Construct the standard vector lp_b */
-        std::vector<double> lp_b(1, 0);
-        lp_b[0] = Cl;
+        std::vector<double>& lp_b = scratch.b;
+        lp_b.assign(1, Cl);
         // Mpath (with last equal constraint) */
         /* Construct the standard vector lp_c */
         const std::vector<double>& lp_c = hatb;
@@ -108,9 +109,9 @@ public:
         printVec("lp_b", lp_b);
         printVec("lp_c", lp_c);
         printVar("lp_fix", Mpath);
-        LPSolver Solver(lp_A, lp_b, lp_c, Mpath);
-        Solver.setMaximization();
-        LPSolver::LPStatus status = Solver.solve(lp_x);
+        lpSolver.update(lp_A, lp_b, lp_c, Mpath);
+        lpSolver.setMaximization();
+        LPSolver::LPStatus status = lpSolver.solve(lp_x);
 //        if (status==LPSolver::ERROR) {
 //            // Uniform random
 //            for (int j = 0; j<K; ++j) {
@@ -120,34 +121,44 @@ public:
         return status;
     }
 
-    void updateState(std::vector<uint> selectedPaths, std::vector<Metric> selectedPathMeasurements) override
+    void updateState(const PathSet<>& selectedPaths, const MetricBlock<>& selectedPathMeasurements) override
     {
-        for (uint i = 0; i<selectedPaths.size(); ++i) {
-            uint k = selectedPaths[i];
-            Metric measurement = selectedPathMeasurements[i];
-
-            double rand_b = unif(randomEngine);
-            double rand_l = unif(randomEngine);
+        std::vector<double>& u = scratch.uniforms;
+        u.resize(2*selectedPaths.size());
+        randomEngine.fillUniform(u);
+        bw.nextRound();
+        loss.nextRound();
+        uint i = 0;
+        for (uint k : selectedPaths) {
+            const Metric& measurement = selectedPathMeasurements[k];
+
+            double rand_b = u[2*i];
+            double rand_l = u[2*i+1];
 
             double tb = bernoulliTrial(rand_b, measurement.b);
             double tl = bernoulliTrial(rand_l, measurement.l);
 
-            if (tb>0.5) { sb[k] += 1; } else { fb[k] += 1; }
-            if (tl>0.5) { sl[k] += 1; } else { fl[k] += 1; }
-
+            bw.observe(k, tb>0.5);
+            loss.observe(k, tl>0.5);
+            ++i;
         }
     }
 
-    std::vector<uint> selectNextPathsAvg(uint M) override
+    void selectNextPathsAvg(uint M, std::vector<uint>& paths) override
     {
 
     }
 
-    void updateStateAvg(std::vector<uint> selectedPaths, std::vector<Metric> selectedPathMeasurements) override
+    void updateStateAvg(const PathSet<>& selectedPaths, const MetricBlock<>& selectedPathMeasurements) override
     {
 
     }
 
+    const std::vector<double>* selectionWeights() override
+    {
+        return fromLP ? &scratch.x : NULL;
+    }
+
     std::string name() override
     {
         return "ConMPTSLoss";
@@ -165,6 +176,22 @@ public:
     {
         return PolicyType::CONMPTS_Loss;
     }
+
+    Policy* clone() const override
+    {
+        return new ConMPTSLoss(*this);
+    }
+
+    bool hasOracle() override
+    {
+        return true;
+    }
+
+    double computeOracle(const std::vector<double>& r, const std::vector<double>& b, uint M,
+            double threshold) override
+    {
+        return computeOracleLoss(r, b, M, threshold);
+    }
 };
 
 } //namespace
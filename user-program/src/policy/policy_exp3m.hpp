@@ -4,13 +4,21 @@
 
 namespace bandit {
 
-class Exp3MPolicy: public Policy {
-    // always init alpha to -1.0
+class Exp3MPolicy final: public Policy {
+    // the cap of the weights relative to the largest one, -1 when none is capped
     double alpha_t = -1.0;
     const uint K;
     const double gamma;
-    std::vector<double> wi;
+    // the natural logs of the weights, which do not overflow and never
+    // reach 0, so that a path far below the others can come back
+    std::vector<double> logw;
+    // the weights relative to the largest one at the last selection, in
+    // (0, 1]; a path 745 nats or more below the largest one is 0 here only
+    std::vector<double> ratio;
     std::vector<double> pi;
+    // the paths by descending weight, and the position of every path in it
+    std::vector<uint> order;
+    std::vector<uint> rank;
 public:
     Exp3MPolicy(uint K, double gamma)
             :K(K), gamma(gamma)
@@ -20,16 +28,29 @@ public:
 
     void reset()
     {
-        wi = std::vector<double>(K, 1.0);
+        logw = std::vector<double>(K, 0.0);
+        ratio = std::vector<double>(K, 1.0);
         pi = std::vector<double>(K, 1.0); //initial value of pi should not be used
+        order.resize(K);
+        rank.resize(K);
+        for (uint k = 0; k<K; ++k) {
+            order[k] = k;
+            rank[k] = k;
+        }
+    }
+
+    // the natural log of the weight of path k
+    double logWeight(uint k) const
+    {
+        return logw[k];
     }
 
-    double getAlpha(double rhs, const std::vector<double>& wsSorted)
+    // s is the sum of the ratios in descending order
+    double getAlpha(double rhs, double s)
     {
-        double s = vectorSum(wsSorted);
         for (uint k = 0; k<K; ++k) {
             double alpha = (rhs*s)/(1-k*rhs);
-            double current = wsSorted[k];
+            double current = ratio[order[k]];
             if (alpha>current) {
                 return alpha;
             }
@@ -39,51 +60,80 @@ public:
         abort();
     }
 
-    std::vector<uint> selectNextPaths(uint l) override
+    // The probabilities need every weight, so a round stays O(K): one
+    // pass for the ratios and their sum, one for the cap, one for pi, and
+    // the rounding. Only the sort of the weights is gone, see reorder().
+    void selectNextPaths(uint l, std::vector<uint>& paths) override
     {
-        const double wsum = vectorSum(wi);
-        std::vector<double> wsSorted(wi);
-        std::sort(wsSorted.begin(), wsSorted.end(), std::greater<double>());
-        double threshold = (1.0/l-gamma/K)*wsum/(1-gamma);
-        std::vector<double> wsd(wi);
-        if (wsSorted[0]>=threshold) {
-            alpha_t = getAlpha((1.0/l-gamma/K)/(1-gamma), wsSorted);
-            for (uint i = 0; i<K; ++i) {
-                wsd[i] = std::min(alpha_t, wi[i]);
-            }
+        const double top = logw[order[0]];
+        // summed in the order of the weights, as the search in getAlpha
+        double sortedSum = 0;
+        for (uint k = 0; k<K; ++k) {
+            const uint i = order[k];
+            ratio[i] = std::exp(logw[i]-top);
+            sortedSum += ratio[i];
+        }
+        const double rhs = (1.0/l-gamma/K)/(1-gamma);
+        std::vector<double>& wsd = scratch.sample2;
+        wsd.resize(K);
+        // the largest ratio is 1
+        if (1.0>=rhs*sortedSum) {
+            alpha_t = getAlpha(rhs, sortedSum);
         }
         else {
             alpha_t = -1.0; // the set S0 is empty
-            for (uint i = 0; i<K; ++i) {
-                wsd[i] = wi[i];
-            }
         }
-        const double wsdsum = vectorSum(wsd);
+        double wsdsum = 0;
+        for (uint i = 0; i<K; ++i) {
+            wsd[i] = alpha_t<0 ? ratio[i] : std::min(alpha_t, ratio[i]);
+            wsdsum += wsd[i];
+        }
         for (uint i = 0; i<K; ++i) {
             pi[i] = l*((1-gamma)*wsd[i]/wsdsum+gamma/K);
         }
-        return dependentRounding(l, pi);
+        dependentRounding(l, pi, scratch.rounding, paths);
     }
 
-    void updateState(std::vector<uint> is, std::vector<Metric> rs) override
+    void updateState(const PathSet<>& is, const MetricBlock<>& rs) override
     {
         const uint l = is.size();
-        for (uint i = 0; i<is.size(); ++i) {
-            uint k = is[i];
-            Metric measurement = rs[i];
+        for (uint k : is) {
+            const Metric& measurement = rs[k];
 
-            if (wi[k]<alpha_t)
+            // the weights capped at alpha_t are not updated, all of them
+            // are updated if none is capped
+            if (alpha_t<0 || ratio[k]<alpha_t) {
                 // using btlbw to adjust the weights
-                wi[k] *= exp(l*gamma*(measurement.b/pi[k])/K);
+                logw[k] += l*gamma*(measurement.b/pi[k])/K;
+                reorder(k);
+            }
+        }
+    }
+
+    // Move path k to its place in order after its weight grew: O(the
+    // positions it moves), O(K) at worst, with no sort.
+    void reorder(uint k)
+    {
+        const double w = logw[k];
+        uint j = rank[k];
+        for (; j>0 && logw[order[j-1]]<w; --j) {
+            order[j] = order[j-1];
+            rank[order[j]] = j;
+        }
+        for (; j+1<K && logw[order[j+1]]>w; ++j) {
+            order[j] = order[j+1];
+            rank[order[j]] = j;
         }
+        order[j] = k;
+        rank[k] = j;
     }
 
-    std::vector<uint> selectNextPathsAvg(uint M) override
+    void selectNextPathsAvg(uint M, std::vector<uint>& paths) override
     {
 
     }
 
-    void updateStateAvg(std::vector<uint> selectedPaths, std::vector<Metric> selectedPathMeasurements) override
+    void updateStateAvg(const PathSet<>& selectedPaths, const MetricBlock<>& selectedPathMeasurements) override
     {
 
     }
@@ -105,6 +155,11 @@ public:
     {
         return PolicyType::EXP3M;
     }
+
+    Policy* clone() const override
+    {
+        return new Exp3MPolicy(*this);
+    }
 };
 
 } //namespace
@@ -0,0 +1,207 @@
+#pragma once
+
+#include "policy.hpp"
+#include "policy_conmpts_latency.hpp"
+#include "policy_conmpts_bandwidth.hpp"
+#include "policy_conmpts_loss.hpp"
+#include "policy_mpts.hpp"
+#include "policy_klucb.hpp"
+#include "policy_exp3m.hpp"
+#include "policy_random.hpp"
+
+#include <functional>
+
+namespace bandit {
+
+// the parameters a policy takes from the command line unless its spec sets them
+struct PolicyDefaults {
+    double threshold;
+    PosteriorParams posterior;
+
+    explicit PolicyDefaults(double threshold = 0.4, const PosteriorParams& posterior = PosteriorParams())
+            :threshold(threshold), posterior(posterior)
+    {
+    }
+};
+
+// A policy of the command line, "name:key=value:key=value". A key that the
+// policy does not read is an error, so that a typo is not silently ignored.
+class PolicySpec {
+public:
+    std::string name;
+
+    explicit PolicySpec(const std::string& spec)
+    {
+        std::vector<std::string> fields = split(spec, ':');
+        name = fields[0];
+        for (uint i = 1; i<fields.size(); ++i) {
+            size_t eq = fields[i].find('=');
+            if (eq==std::string::npos || eq==0) {
+                fail("expected key=value, got '"+fields[i]+"'");
+            }
+            params[fields[i].substr(0, eq)] = fields[i].substr(eq+1);
+        }
+    }
+
+    std::string getString(const std::string& key, const std::string& def)
+    {
+        used.insert(key);
+        auto it = params.find(key);
+        return it==params.end() ? def : it->second;
+    }
+
+    double getDouble(const std::string& key, double def)
+    {
+        std::string value = getString(key, "");
+        if (value.empty()) {
+            return def;
+        }
+        char* end;
+        double d = std::strtod(value.c_str(), &end);
+        if (*end!='\0') {
+            fail(key+" is not a number: '"+value+"'");
+        }
+        return d;
+    }
+
+    uint getUint(const std::string& key, uint def)
+    {
+        std::string value = getString(key, "");
+        if (value.empty()) {
+            return def;
+        }
+        char* end;
+        unsigned long u = std::strtoul(value.c_str(), &end, 10);
+        if (*end!='\0' || value[0]=='-') {
+            fail(key+" is not an unsigned integer: '"+value+"'");
+        }
+        return uint(u);
+    }
+
+    bool getBool(const std::string& key, bool def)
+    {
+        std::string value = getString(key, "");
+        if (value.empty()) {
+            return def;
+        }
+        if (value=="1" || value=="true") {
+            return true;
+        }
+        if (value=="0" || value=="false") {
+            return false;
+        }
+        fail(key+" is not a bool: '"+value+"'");
+        return def;
+    }
+
+    // the keys posterior, discount and window
+    PosteriorParams getPosterior(const PosteriorParams& def)
+    {
+        std::string mode = getString("posterior", "");
+        return PosteriorParams(mode.empty() ? def.mode : posteriorModeFromString(mode),
+                getDouble("discount", def.discount), getUint("window", def.window));
+    }
+
+    void checkAllUsed()
+    {
+        for (const auto& param : params) {
+            if (used.count(param.first)==0) {
+                fail("unknown parameter '"+param.first+"'");
+            }
+        }
+    }
+
+    void fail(const std::string& msg) const
+    {
+        std::cerr << "Policy " << name << ": " << msg << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+private:
+    std::map<std::string, std::string> params;
+    std::set<std::string> used;
+};
+
+typedef std::function<PolicyPtr(uint K, PolicySpec& spec, const PolicyDefaults& defaults)> PolicyCreator;
+
+// Policies by name. The policies of this tree are registered on first use;
+// add() registers another one.
+class PolicyFactory {
+public:
+    static void add(const std::string& name, const PolicyCreator& creator)
+    {
+        registry()[name] = creator;
+    }
+
+    static PolicyPtr create(const std::string& spec, uint K, const PolicyDefaults& defaults)
+    {
+        PolicySpec policySpec(spec);
+        auto it = registry().find(policySpec.name);
+        if (it==registry().end()) {
+            policySpec.fail("unknown policy, one of: "+names());
+        }
+        PolicyPtr policy = it->second(K, policySpec, defaults);
+        policySpec.checkAllUsed();
+        return policy;
+    }
+
+    // a comma separated list of specs, run side by side
+    static std::vector<PolicyPtr> createAll(const std::string& specs, uint K, const PolicyDefaults& defaults)
+    {
+        std::vector<PolicyPtr> policies;
+        for (const auto& spec : split(specs, ',')) {
+            policies.push_back(create(spec, K, defaults));
+        }
+        return policies;
+    }
+
+    static std::string names()
+    {
+        std::string all;
+        for (const auto& entry : registry()) {
+            all += (all.empty() ? "" : " | ")+entry.first;
+        }
+        return all;
+    }
+
+private:
+    static std::map<std::string, PolicyCreator>& registry()
+    {
+        static std::map<std::string, PolicyCreator> creators = builtins();
+        return creators;
+    }
+
+    static std::map<std::string, PolicyCreator> builtins()
+    {
+        std::map<std::string, PolicyCreator> creators;
+        creators["conmpts-latency"] = [](uint K, PolicySpec& spec, const PolicyDefaults& defaults) {
+            return PolicyPtr(new ConMPTSLatency(K, spec.getDouble("threshold", defaults.threshold),
+                    spec.getDouble("s", 1), spec.getDouble("f", 1), spec.getPosterior(defaults.posterior)));
+        };
+        creators["conmpts-bandwidth"] = [](uint K, PolicySpec& spec, const PolicyDefaults& defaults) {
+            return PolicyPtr(new ConMPTSBandwidth(K, spec.getDouble("threshold", defaults.threshold),
+                    spec.getDouble("s", 1), spec.getDouble("f", 1), spec.getPosterior(defaults.posterior)));
+        };
+        creators["conmpts-loss"] = [](uint K, PolicySpec& spec, const PolicyDefaults& defaults) {
+            return PolicyPtr(new ConMPTSLoss(K, spec.getDouble("threshold", defaults.threshold),
+                    spec.getDouble("s", 1), spec.getDouble("f", 1), spec.getPosterior(defaults.posterior)));
+        };
+        creators["mpts"] = [](uint K, PolicySpec& spec, const PolicyDefaults& defaults) {
+            return PolicyPtr(new class MPTS(K, spec.getBool("basic", true), spec.getDouble("alpha", 1),
+                    spec.getDouble("beta", 1), spec.getPosterior(defaults.posterior)));
+        };
+        creators["klucb"] = [](uint K, PolicySpec& spec, const PolicyDefaults&) {
+            return PolicyPtr(new KLUCBPolicy(K, spec.getBool("basic", true),
+                    spec.getDouble("tolerance", KLUCB_LOGN_TOLERANCE)));
+        };
+        creators["exp3m"] = [](uint K, PolicySpec& spec, const PolicyDefaults&) {
+            return PolicyPtr(new Exp3MPolicy(K, spec.getDouble("gamma", 0.1)));
+        };
+        creators["random"] = [](uint K, PolicySpec&, const PolicyDefaults&) {
+            return PolicyPtr(new RandomPolicy(K));
+        };
+        return creators;
+    }
+};
+
+} //namespace
@@ -4,13 +4,33 @@
 
 namespace bandit {
 
-class KLUCBPolicy: public Policy {
+// the default relative band of log(n) in which the cached indices are kept
+const double KLUCB_LOGN_TOLERANCE = 0.01;
+
+// The index of a path only changes when the path is played or when log(n)
+// grows. The indices are cached; a round solves those of the paths played
+// in the previous round, with the log(n) of the last full refresh, and all
+// of them when log(n) grew by more than the tolerance. With a tolerance of
+// 0 every index is solved in every round.
+class KLUCBPolicy final: public Policy {
     const uint K;
     std::vector<int> Ni;
     std::vector<double> Gi;
     const double DELTA;
     const double EPS;
     bool basic;
+    const double tolerance;
+
+    // the number of plays, sum of Ni
+    int n;
+    // cached indices, solved with log(n) = cachedLogN
+    std::vector<double> ucb;
+    std::vector<bool> stale;
+    double cachedLogN;
+    // the lanes of klUpperBatch
+    std::vector<uint> batchIds;
+    std::vector<double> batchP, batchLevel, batchQ;
+    std::vector<char> batchDone;
 
     double kl(double p, double q)
     { //calculate kl-divergence
@@ -24,8 +44,8 @@ class KLUCBPolicy: public Policy {
     }
 
 public:
-    KLUCBPolicy(int K, bool basic = true)
-            :K(K), DELTA(1e-8), EPS(1e-12), basic(basic)
+    KLUCBPolicy(int K, bool basic = true, double tolerance = KLUCB_LOGN_TOLERANCE)
+            :K(K), DELTA(1e-8), EPS(1e-12), basic(basic), tolerance(tolerance)
     {
         reset();
     }
@@ -34,6 +54,15 @@ public:
     {
         Ni = std::vector<int>(K, 0);
         Gi = std::vector<double>(K, 0.0);
+        n = 0;
+        ucb.assign(K, 0);
+        stale.assign(K, true);
+        cachedLogN = 0;
+        batchIds.reserve(K);
+        batchP.reserve(K);
+        batchLevel.reserve(K);
+        batchQ.resize(K);
+        batchDone.resize(K);
     }
 
     double getKLUCBUpper(int k, int n)
@@ -58,74 +87,123 @@ public:
         return q;
     }
 
-    std::vector<uint> selectNextPaths(uint l) override
+    // The Newton iteration of getKLUCBUpper on the m lanes of batchP and
+    // batchLevel (log(n)/Ni) together, into batchQ. A converged lane keeps
+    // its q, so every lane takes the same steps as in getKLUCBUpper, and
+    // the loop over the lanes has no branches.
+    void klUpperBatch(uint m)
     {
-        const double n = vectorSum(Ni);
-        if (basic) {
-            std::vector<double> indices = std::vector<double>(K, 0.0);
-            for (uint k = 0; k<K; ++k) {
-                //KL-UCB index
-                if (Ni[k]==0) {
-                    indices[k] = 100000000; //very large number
-                }
-                else {
-                    indices[k] = getKLUCBUpper(k, n);
-                }
+        uint active = 0;
+        for (uint i = 0; i<m; ++i) {
+            batchDone[i] = batchP[i]>=1;
+            batchQ[i] = batchDone[i] ? 1 : batchP[i]+DELTA;
+            active += !batchDone[i];
+        }
+        for (int t = 0; t<20 && active>0; ++t) {
+            active = 0;
+            for (uint i = 0; i<m; ++i) {
+                const double p = batchP[i];
+                const double q = batchQ[i];
+                const double f = batchLevel[i]-kl(p, q);
+                const double df = -dkl(p, q);
+                const bool done = batchDone[i] || f*f<EPS;
+                const double next = std::min(1-DELTA, std::max(q-f/df, p+DELTA));
+                batchQ[i] = done ? q : next;
+                batchDone[i] = done;
+                active += !done;
             }
-            std::vector<uint> targetPaths = vectorMaxIndices(indices, l);
-            return targetPaths;
+        }
+    }
+
+    // solve the stale indices, or all of them if log(n) left the band
+    void refreshIndices()
+    {
+        if (n==0) {
+            return;
+        }
+        const double logn = log(n);
+        if (logn>cachedLogN*(1+tolerance) || logn<cachedLogN) {
+            cachedLogN = logn;
+            stale.assign(K, true);
+        }
+        batchIds.clear();
+        batchP.clear();
+        batchLevel.clear();
+        for (uint k = 0; k<K; ++k) {
+            if (stale[k] && Ni[k]>0) {
+                batchIds.push_back(k);
+                batchP.push_back(std::max(Gi[k]/(double) Ni[k], DELTA));
+                batchLevel.push_back(cachedLogN/(double) Ni[k]);
+            }
+        }
+        klUpperBatch(batchIds.size());
+        for (uint i = 0; i<batchIds.size(); ++i) {
+            ucb[batchIds[i]] = batchQ[i];
+            stale[batchIds[i]] = false;
+        }
+    }
+
+    // The cache saves the Newton solves, not the scans: finding the stale
+    // paths and the l largest indices stays O(K) per round. A structure
+    // ordered by index would only pay off for a K far above the M updates
+    // of a round, and a full refresh reorders all of it anyway.
+    void selectNextPaths(uint l, std::vector<uint>& paths) override
+    {
+        refreshIndices();
+        for (uint k = 0; k<K; ++k) {
+            //KL-UCB index
+            if (Ni[k]==0) {
+                ucb[k] = 100000000; //very large number
+            }
+        }
+        if (basic) {
+            vectorMaxIndices(ucb, l, scratch.ranked, paths);
         }
         else {
-            std::vector<double> means(K, 0.0);
+            std::vector<double>& means = scratch.sample1;
+            means.resize(K);
             for (uint i = 0; i<K; ++i) {
                 means[i] = (Gi[i]+1)/(Ni[i]+1);
             }
-            std::vector<uint> meanIndices = vectorMaxIndices(means, l); //l-1 ko wo means de
-            std::map<uint, bool> meanIndicesMap;
+            std::vector<uint>& meanIndices = paths;
+            vectorMaxIndices(means, l, scratch.ranked, meanIndices); //l-1 ko wo means de
+            std::vector<bool>& isMeanIndex = scratch.flags;
+            isMeanIndex.assign(K, false);
             for (uint i = 0; i<l-1; ++i) { //l-1 <- notice
-                meanIndicesMap[meanIndices[i]] = true;
+                isMeanIndex[meanIndices[i]] = true;
             }
 
-            std::vector<double> ucbIndices = std::vector<double>(K, 0.0);
-            for (uint k = 0; k<K; ++k) {
-                //KL-UCB index
-                if (Ni[k]==0) {
-                    ucbIndices[k] = 100000000; //very large number
-                }
-                else {
-                    ucbIndices[k] = getKLUCBUpper(k, n);
-                }
-            }
-            std::vector<uint> ucbPaths = vectorMaxIndices(ucbIndices, l);
+            std::vector<uint>& ucbPaths = scratch.indices;
+            vectorMaxIndices(ucb, l, scratch.ranked, ucbPaths);
 
             for (uint i = 0; i<l; ++i) {
                 uint index = ucbPaths[i];
-                if (meanIndicesMap.find(index)==meanIndicesMap.end()) {
+                if (!isMeanIndex[index]) {
                     meanIndices[l-1] = index;
                     break;
                 }
             }
-            return meanIndices;
         }
 
     }
 
 
-    void updateState(std::vector<uint> is, std::vector<Metric> rs) override
+    void updateState(const PathSet<>& is, const MetricBlock<>& rs) override
     {
-        for (uint i = 0; i<is.size(); ++i) {
-            uint k = is[i];
+        for (uint k : is) {
             Ni[k] += 1;
-            Gi[k] += rs[i].b; // using btlbw to adjust the gain
+            Gi[k] += rs[k].b; // using btlbw to adjust the gain
+            n += 1;
+            stale[k] = true;
         }
     }
 
-    std::vector<uint> selectNextPathsAvg(uint M) override
+    void selectNextPathsAvg(uint M, std::vector<uint>& paths) override
     {
 
     }
 
-    void updateStateAvg(std::vector<uint> selectedPaths, std::vector<Metric> selectedPathMeasurements) override
+    void updateStateAvg(const PathSet<>& selectedPaths, const MetricBlock<>& selectedPathMeasurements) override
     {
 
     }
@@ -145,6 +223,11 @@ public:
     {
         return PolicyType::KLUCB;
     }
+
+    Policy* clone() const override
+    {
+        return new KLUCBPolicy(*this);
+    }
 };
 
 } //namespace
@@ -5,50 +5,37 @@
 namespace bandit {
 
 //Unconstrained Multi-played Thompson sampling (binary reward)
-class MPTS: public Policy {
+class MPTS final: public Policy {
     const uint K;
-    std::vector<double> alphas, betas;
+    BetaPosterior posterior;
 public:
-    MPTS(uint K, bool basic = true, double alpha = 1, double beta = 1)
-            :K(K)
+    MPTS(uint K, bool basic = true, double alpha = 1, double beta = 1,
+            const PosteriorParams& posteriorParams = PosteriorParams())
+            :K(K), posterior(K, alpha, beta, posteriorParams)
     {
-        for (uint i = 0; i<K; ++i) {
-            alphas.push_back(alpha);
-            betas.push_back(beta);
-        }
     }
 
-    std::vector<uint> selectNextPaths(uint m) override
+    void selectNextPaths(uint m, std::vector<uint>& paths) override
     {
-        std::vector<double> thetas(K, 0.0);
-        for (uint i = 0; i<K; ++i) {
-            thetas[i] = beta_distribution<double>(alphas[i], betas[i])(randomEngine);
-        }
-        std::vector<uint> thetaIndices = vectorMaxIndices(thetas, m);
-
-        return thetaIndices;
+        std::vector<double>& thetas = scratch.sample1;
+        sampleBeta(posterior.alphas(), posterior.betas(), thetas, randomEngine, scratch.beta);
+        vectorMaxIndices(thetas, m, scratch.ranked, paths);
     }
 
-    void updateState(std::vector<uint> is, std::vector<Metric> rs) override
+    void updateState(const PathSet<>& is, const MetricBlock<>& rs) override
     {
-        for (uint i = 0; i<is.size(); ++i) {
-            uint k = is[i];
-            double b = rs[i].b;
-            if (b>0.5) {
-                alphas[k] += 1;
-            }
-            else {
-                betas[k] += 1;
-            }
+        posterior.nextRound();
+        for (uint k : is) {
+            posterior.observe(k, rs[k].b>0.5);
         }
     }
 
-    std::vector<uint> selectNextPathsAvg(uint M) override
+    void selectNextPathsAvg(uint M, std::vector<uint>& paths) override
     {
 
     }
 
-    void updateStateAvg(std::vector<uint> selectedPaths, std::vector<Metric> selectedPathMeasurements) override
+    void updateStateAvg(const PathSet<>& selectedPaths, const MetricBlock<>& selectedPathMeasurements) override
     {
 
     }
@@ -68,6 +55,11 @@ public:
     {
         return PolicyType::MPTS;
     }
+
+    Policy* clone() const override
+    {
+        return new MPTS(*this);
+    }
 };
 
 } //namespace
@@ -4,7 +4,7 @@
 
 namespace bandit {
 
-class RandomPolicy: public Policy {
+class RandomPolicy final: public Policy {
     const uint K;
 public:
     RandomPolicy(uint K)
@@ -12,32 +12,40 @@ public:
     {
     }
 
-    std::vector<uint> selectNextPaths(uint l) override
+    void selectNextPaths(uint l, std::vector<uint>& paths) override
     {
-        std::map<uint, bool> pathsMap;
-        while (pathsMap.size()<l) {
-            pathsMap[std::uniform_int_distribution<int>(0, K-1)(randomEngine)] = true;
+        // draw until l distinct paths are hit, returned in increasing order
+        std::vector<bool>& picked = scratch.flags;
+        picked.assign(K, false);
+        uint n = 0;
+        while (n<l) {
+            const uint k = std::uniform_int_distribution<int>(0, K-1)(randomEngine);
+            if (!picked[k]) {
+                picked[k] = true;
+                ++n;
+            }
         }
-        std::vector<uint> paths;
-        for (const auto& it: pathsMap) {
-            paths.push_back(it.first);
+        paths.clear();
+        for (uint k = 0; k<K; ++k) {
+            if (picked[k]) {
+                paths.push_back(k);
+            }
         }
-        return paths;
     }
 
 
-    void updateState(std::vector<uint>, std::vector<Metric>) override
+    void updateState(const PathSet<>&, const MetricBlock<>&) override
     {
         // do not remember anything
     }
 
 
-    std::vector<uint> selectNextPathsAvg(uint M) override
+    void selectNextPathsAvg(uint M, std::vector<uint>& paths) override
     {
 
     }
 
-    void updateStateAvg(std::vector<uint> selectedPaths, std::vector<Metric> selectedPathMeasurements) override
+    void updateStateAvg(const PathSet<>& selectedPaths, const MetricBlock<>& selectedPathMeasurements) override
     {
 
     }
@@ -57,6 +65,11 @@ public:
     {
         return PolicyType::RANDOM;
     }
+
+    Policy* clone() const override
+    {
+        return new RandomPolicy(*this);
+    }
 };
 
 } //namespace
@@ -0,0 +1,55 @@
+// Averages a round log streamed with --stream into the text format of
+// RoundwiseFullLogWriter.
+
+#include "../cmdline.h"
+#include "../bandit/roundwiselog.hpp"
+#include "../bandit/streamlog.hpp"
+
+using namespace std;
+using namespace bandit;
+
+int main(int argc, char* argv[])
+{
+    cmdline::parser cmd;
+    cmd.add<string>("input", 'i', "binary round log written with --stream", true, "");
+    cmd.add<string>("output", 'o', "output filename", false, "pathLog.txt");
+    cmd.parse_check(argc, argv);
+    const string inputFile = cmd.get<string>("input");
+    const string outputFile = cmd.get<string>("output");
+
+    StreamLogReader reader(inputFile);
+    const uint K = reader.header.K;
+    const uint P = reader.header.P;
+
+    // the number of rounds is only known from the records in the forever mode
+    StreamRecord record;
+    std::vector<Metric> metrics;
+    uint T = reader.header.T;
+    uint simulations = 0;
+    while (reader.next(record, metrics)) {
+        T = std::max<uint>(T, record.round+1);
+        simulations = std::max<uint>(simulations, record.simulation+1);
+    }
+    if (simulations==0) {
+        std::cerr << "logavg: " << inputFile << " has no rounds" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    RoundwiseFullLog log(P, T, K, false);
+    for (uint i = 0; i<simulations; ++i) {
+        log.addSimulation();
+    }
+    reader.rewind();
+    while (reader.next(record, metrics)) {
+        for (uint i = 0; i<K; ++i) {
+            if (record.mask & (uint64_t(1) << i)) {
+                log.recordSelectedPaths(record.policy, record.round, i);
+            }
+            log.recordMeasurements(record.policy, record.round, i, metrics[i]);
+        }
+    }
+
+    cout << "Averaged " << simulations << " simulations of " << T << " rounds in: " << outputFile << endl;
+    RoundwiseFullLogWriter::fullLogWrite(log, T, reader.policyNames, outputFile);
+    return 0;
+}
@@ -0,0 +1,96 @@
+// Per-sample cost of the Beta posteriors versus the number of paths K:
+// a beta_distribution per element against one sampleBeta call for all K,
+// for the parameters of the early rounds (small integers, the order
+// statistic), of later rounds (larger integers) and real ones (the gamma
+// lanes, as with a discount).
+//
+//     olms-bench-beta [rounds]
+
+#include <chrono>
+
+#include "bandit/distributions.hpp"
+
+using namespace bandit;
+
+typedef std::chrono::steady_clock Clock;
+
+// the parameters of path i in round t
+typedef double (*Parameter)(uint i, uint t);
+
+double smallInteger(uint i, uint t)
+{
+    return 1+(i+t)%3;
+}
+
+double largeInteger(uint i, uint t)
+{
+    return 1+(i*37+t)%500;
+}
+
+double real(uint i, uint t)
+{
+    return 0.5+0.37*((i*13+t)%97);
+}
+
+void fill(Parameter param, uint K, uint t, std::vector<double>& a, std::vector<double>& b)
+{
+    for (uint i = 0; i<K; ++i) {
+        a[i] = param(i, t);
+        b[i] = param(i+K, t);
+    }
+}
+
+// ns per sample of a beta_distribution per element
+double perElement(Parameter param, uint K, uint T, double& sink)
+{
+    std::vector<double> a(K), b(K), out(K);
+    double ns = 0;
+    for (uint t = 0; t<T; ++t) {
+        fill(param, K, t, a, b);
+        const Clock::time_point start = Clock::now();
+        for (uint i = 0; i<K; ++i) {
+            beta_distribution<double> beta(a[i], b[i]);
+            out[i] = beta(randomEngine);
+        }
+        ns += std::chrono::duration<double, std::nano>(Clock::now()-start).count();
+        sink += out[t%K];
+    }
+    return ns/T/K;
+}
+
+// ns per sample of one sampleBeta call for all K
+double batch(Parameter param, uint K, uint T, double& sink)
+{
+    std::vector<double> a(K), b(K), out(K);
+    BetaScratch scratch;
+    double ns = 0;
+    for (uint t = 0; t<T; ++t) {
+        fill(param, K, t, a, b);
+        const Clock::time_point start = Clock::now();
+        sampleBeta(a, b, out, randomEngine, scratch);
+        ns += std::chrono::duration<double, std::nano>(Clock::now()-start).count();
+        sink += out[t%K];
+    }
+    return ns/T/K;
+}
+
+int main(int argc, char** argv)
+{
+    const uint T = argc>1 ? (uint) std::strtoul(argv[1], NULL, 10) : 20000;
+    const char* names[] = {"int a,b<=3", "int a,b<=500", "real"};
+    const Parameter params[] = {smallInteger, largeInteger, real};
+    double sink = 0;
+
+    seedRun(1, 0);
+    std::cout << "# parameters\tK\tper element (ns)\tsampleBeta (ns)\tspeedup" << std::endl;
+    for (uint p = 0; p<3; ++p) {
+        for (uint K : {4u, 8u, 16u, 32u, 64u}) {
+            const double element = perElement(params[p], K, T, sink);
+            const double batched = batch(params[p], K, T, sink);
+            std::cout << names[p] << "\t" << K << "\t" << element << "\t" << batched << "\t" << element/batched
+                      << std::endl;
+        }
+    }
+    // keeps the samples alive
+    return sink<0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+// Rounds per second of the simulator with virtual calls, on the Policy
+// and Path bases, against the same run with the final policy and path
+// classes bound at compile time, versus the number of paths K. Both run
+// the same rounds on fresh copies from one seed; the best of REPEATS
+// alternating runs is kept.
+//
+//     olms-bench-dispatch [rounds]
+
+#include <chrono>
+
+#include "bandit/init_util.hpp"
+
+using namespace bandit;
+
+const uint REPEATS = 3;
+
+// the simulator without any logging
+struct NullLog {
+    bool forever = false;
+
+    void addSimulation() {}
+    void recordSelectedPaths(uint, uint, uint) {}
+    void recordMeasurements(uint, uint, uint, const Metric&) {}
+    void endRound(uint, uint) {}
+    void close() {}
+};
+
+// rounds per second of T rounds on PolicyT and PathT
+template<class PolicyT, class PathT>
+double roundsPerSecond(const std::vector<PathPtr>& paths, const std::vector<PolicyPtr>& policies, uint M,
+        double threshold, uint T)
+{
+    typedef std::chrono::steady_clock Clock;
+    NullLog log;
+    seedRun(1, 0);
+    const Clock::time_point start = Clock::now();
+    simulateCopies<PolicyT, PathT>(log, T, M, threshold, paths, policies, 0);
+    return T/std::chrono::duration<double>(Clock::now()-start).count();
+}
+
+// the virtual and the static simulator on policy name of type PolicyT
+template<class PolicyT>
+void compare(const char* name, uint M, double threshold, uint T)
+{
+    for (uint K : {4u, 8u, 16u, 32u, 64u}) {
+        std::vector<PathPtr> paths;
+        for (uint i = 0; i<K; ++i) {
+            paths.push_back(PathPtr(new BernoulliPath(Metric(0.1+0.8*i/K, 0.9-0.8*i/K, 0.1))));
+        }
+        std::vector<PolicyPtr> policies = {PolicyFactory::create(name, K, PolicyDefaults(threshold))};
+        double dynamic = 0, fixed = 0;
+        for (uint r = 0; r<REPEATS; ++r) {
+            dynamic = std::max(dynamic, roundsPerSecond<Policy, Path>(paths, policies, M, threshold, T));
+            fixed = std::max(fixed, roundsPerSecond<PolicyT, BernoulliPath>(paths, policies, M, threshold, T));
+        }
+        std::cout << name << "\t" << K << "\t" << dynamic << "\t" << fixed << "\t" << fixed/dynamic << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const uint T = argc>1 ? (uint) std::strtoul(argv[1], NULL, 10) : 100000;
+    const uint M = 2;
+    const double threshold = 0.4;
+
+    std::cout << "# policy\tK\tvirtual (rounds/s)\tstatic (rounds/s)\tspeedup" << std::endl;
+    compare<RandomPolicy>("random", M, threshold, T);
+    compare<class MPTS>("mpts", M, threshold, T);
+    compare<KLUCBPolicy>("klucb", M, threshold, T);
+    compare<Exp3MPolicy>("exp3m", M, threshold, T);
+    compare<ConMPTSLatency>("conmpts-latency", M, threshold, T);
+    return 0;
+}
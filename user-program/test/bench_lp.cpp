@@ -0,0 +1,89 @@
+// Per-call latency of the ConMPTS policies versus the number of paths K:
+// the mean and the worst time of a decision, i.e. selectNextPaths and
+// updateState with the LP kept alive across rounds. Their LPs all have a
+// closed form, so then the same for an LP of no closed form, which GLPK
+// solves warm from the last basis after update() rewrote the rows that
+// changed.
+//
+//     olms-bench-lp [rounds]
+
+#include "bandit/init_util.hpp"
+
+using namespace bandit;
+
+// the simulator without any logging
+struct NullLog {
+    bool forever = false;
+
+    void addSimulation() {}
+    void recordSelectedPaths(uint, uint, uint) {}
+    void recordMeasurements(uint, uint, uint, const Metric&) {}
+    void endRound(uint, uint) {}
+    void close() {}
+};
+
+// Two budget rows over the K paths and the choice of M of them, with the
+// coefficients drifting every call as the estimates of a policy do.
+DecisionTime benchGeneral(uint K, uint M, uint T, uint& errors)
+{
+    typedef std::chrono::steady_clock Clock;
+    LPSolver solver;
+    CSRMatrix A(K);
+    std::vector<double> b = {0.5*M, 0.5*M}, c(K), x;
+    DecisionTime time;
+
+    solver.setMaximization();
+    errors = 0;
+    for (uint t = 0; t<T; ++t) {
+        const Clock::time_point start = Clock::now();
+        A.clear(K);
+        for (uint row = 0; row<2; ++row) {
+            for (uint i = 0; i<K; ++i) {
+                A.push(i, 0.1+0.8*std::fmod(0.618*(i+row*K)+0.001*t, 1.0));
+            }
+            A.nextRow();
+        }
+        for (uint i = 0; i<K; ++i) {
+            A.push(i, 1.0);
+            c[i] = 0.1+0.8*std::fmod(0.382*i+0.002*t, 1.0);
+        }
+        A.nextRow();
+        solver.update(A, b, c, M);
+        errors += solver.solve(x)!=LPSolver::FEASIBLE;
+        time.add(std::chrono::duration<double, std::nano>(Clock::now()-start).count());
+    }
+    return time;
+}
+
+int main(int argc, char** argv)
+{
+    const uint T = argc>1 ? (uint) std::strtoul(argv[1], NULL, 10) : 20000;
+    const uint M = 2;
+    const double threshold = 0.4;
+
+    std::cout << "# policy\tK\tmean (us)\tmax (us)" << std::endl;
+    for (const char* name : {"conmpts-latency", "conmpts-bandwidth", "conmpts-loss"}) {
+        for (uint K : {4u, 8u, 16u, 32u, 64u}) {
+            std::vector<PathPtr> paths;
+            for (uint i = 0; i<K; ++i) {
+                paths.push_back(PathPtr(new BernoulliPath(Metric(0.1+0.8*i/K, 0.9-0.8*i/K, 0.1))));
+            }
+            std::vector<PolicyPtr> policies = {PolicyFactory::create(name, K, PolicyDefaults(threshold))};
+            Simulator<Policy, Path, NullLog> simulator(paths, policies, M, threshold, 0);
+            NullLog log;
+            seedRun(1, 0);
+            simulator.runSimulation(log, T);
+            const DecisionTime& time = simulator.getDecisionTimes()[0];
+            std::cout << name << "\t" << K << "\t" << time.meanUs() << "\t" << time.maxNs/1000 << std::endl;
+        }
+    }
+
+    std::cout << "# general LP\tK\tmean (us)\tmax (us)\tinfeasible" << std::endl;
+    for (uint K : {4u, 8u, 16u, 32u, 64u}) {
+        uint errors;
+        const DecisionTime time = benchGeneral(K, M, T, errors);
+        std::cout << "glpk-warm\t" << K << "\t" << time.meanUs() << "\t" << time.maxNs/1000 << "\t" << errors
+                  << std::endl;
+    }
+    return 0;
+}
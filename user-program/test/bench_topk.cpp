@@ -0,0 +1,89 @@
+// Per-call cost of vectorMaxIndices versus K and l: the sort of all
+// (key, index) pairs it replaced, as std::stable_sort of the indices and
+// as std::sort of the pairs, against topIndices, which takes the insertion
+// array up to l=TOP_INSERTION_MAX and the stable sort above.
+//
+//     olms-bench-topk [calls]
+
+#include <chrono>
+
+#include "bandit/bandit_util.hpp"
+
+using namespace bandit;
+
+typedef std::chrono::steady_clock Clock;
+
+// the l largest by a stable sort of all indices
+void stableSortMax(const std::vector<double>& elems, uint l, std::vector<uint>& order, std::vector<uint>& is)
+{
+    order.resize(elems.size());
+    for (uint i = 0; i<order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&elems](uint a, uint b) { return elems[a]>elems[b]; });
+    is.assign(order.begin(), order.begin()+std::min<size_t>(l, order.size()));
+}
+
+// the l largest by a sort of all pairs
+void sortMax(const std::vector<double>& elems, uint l, std::vector<std::pair<double, uint>>& elemPairs,
+        std::vector<uint>& is)
+{
+    elemPairs.clear();
+    for (uint i = 0; i<elems.size(); ++i) {
+        elemPairs.push_back(std::make_pair(-elems[i], i));
+    }
+    std::sort(elemPairs.begin(), elemPairs.end());
+    is.clear();
+    for (uint i = 0; i<elemPairs.size() && i<l; ++i) {
+        is.push_back(elemPairs[i].second);
+    }
+}
+
+// ns per call of f over keys that move every call, as the indices of a policy
+template<class F>
+double perCall(uint K, uint N, std::vector<uint>& is, uint& sink, F f)
+{
+    std::vector<double> elems(K);
+    std::uniform_real_distribution<double> unif(0, 1);
+    seedRun(1, 0);
+    for (auto& e : elems) {
+        e = unif(randomEngine);
+    }
+    const Clock::time_point start = Clock::now();
+    for (uint n = 0; n<N; ++n) {
+        elems[n%K] = unif(randomEngine);
+        f(elems);
+        sink += is[0];
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now()-start).count()/N;
+}
+
+int main(int argc, char** argv)
+{
+    const uint N = argc>1 ? (uint) std::strtoul(argv[1], NULL, 10) : 200000;
+    std::vector<std::pair<double, uint>> elemPairs;
+    std::vector<uint> order, ranked, is;
+    uint sink = 0;
+
+    std::cout << "# K\tl\tstable_sort (ns)\tsort (ns)\ttopIndices (ns)\tspeedup" << std::endl;
+    for (uint K : {4u, 8u, 16u, 32u, 64u}) {
+        for (uint l : {1u, 2u, 4u, 8u, 16u, 32u}) {
+            if (l>K) {
+                continue;
+            }
+            const double stable = perCall(K, N, is, sink, [&](const std::vector<double>& elems) {
+                stableSortMax(elems, l, order, is);
+            });
+            const double sorted = perCall(K, N, is, sink, [&](const std::vector<double>& elems) {
+                sortMax(elems, l, elemPairs, is);
+            });
+            const double top = perCall(K, N, is, sink, [&](const std::vector<double>& elems) {
+                vectorMaxIndices(elems, l, ranked, is);
+            });
+            std::cout << K << "\t" << l << "\t" << stable << "\t" << sorted << "\t" << top << "\t" << stable/top
+                      << std::endl;
+        }
+    }
+    // keeps the selections alive
+    return sink==0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+// A round in steady state must not allocate: every policy runs a few warm
+// rounds, then the global operator new counts the allocations of N more.
+//
+//     olms-test-alloc [rounds]
+
+#include <cstdlib>
+#include <new>
+
+static long allocations = 0;
+
+void* operator new(std::size_t n)
+{
+    ++allocations;
+    void* p = std::malloc(n ? n : 1);
+    if (p==NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+// the sized deallocation of C++14, which would not go through the one above
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+#include "bandit/init_util.hpp"
+
+using namespace bandit;
+
+const uint WARM_ROUNDS = 10;
+
+int main(int argc, char** argv)
+{
+    const uint T = argc>1 ? (uint) std::strtoul(argv[1], NULL, 10) : 2000;
+    const uint K = 4, M = 2;
+    const double r[] = {0.2, 0.3, 0.5, 0.6}, b[] = {0.3, 0.2, 0.6, 0.4};
+
+    std::vector<PathPtr> paths;
+    for (uint i = 0; i<K; ++i) {
+        paths.push_back(PathPtr(new BernoulliPath(Metric(r[i], b[i], 0.1))));
+    }
+    std::vector<PolicyPtr> policies;
+    initPolicies(policies, K, "conmpts-latency,conmpts-loss:threshold=0.8,conmpts-bandwidth:threshold=1.5,"
+            "mpts,klucb,exp3m,random", PolicyDefaults());
+
+    RoundwiseFullLog log(policies.size(), WARM_ROUNDS+T, K, false);
+    Simulator<Policy, Path, RoundwiseFullLog> simulator(paths, policies, M, 0.4, 0);
+    log.addSimulation();
+    seedRun(1, 0);
+    for (uint t = 0; t<WARM_ROUNDS; ++t) {
+        for (uint p = 0; p<policies.size(); ++p) {
+            simulator.execSingleRound(log, p, t);
+        }
+    }
+
+    for (uint p = 0; p<policies.size(); ++p) {
+        const long before = allocations;
+        for (uint t = WARM_ROUNDS; t<WARM_ROUNDS+T; ++t) {
+            simulator.execSingleRound(log, p, t);
+        }
+        const long allocated = allocations-before;
+        std::cout << policies[p]->name() << ": " << allocated << " allocations in " << T << " rounds"
+                  << std::endl;
+        if (allocated!=0) {
+            std::cerr << "FAILED: " << policies[p]->name() << " allocates in steady state" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // an LP given as a dense matrix is refilled in place
+    LPSolver solver;
+    Matrix A(3, K);
+    std::vector<double> lp_b = {1.0, 1.0}, lp_c(K, 0.5);
+    long allocated = 0;
+    for (uint t = 0; t<WARM_ROUNDS+T; ++t) {
+        const long before = allocations;
+        for (uint i = 0; i<K; ++i) {
+            A[0][i] = r[i]+0.001*t;
+            A[1][i] = b[i];
+            A[2][i] = 1.0;
+        }
+        solver.update(A, lp_b, lp_c, M);
+        if (t>=WARM_ROUNDS) {
+            allocated += allocations-before;
+        }
+    }
+    std::cout << "LPSolver::update(Matrix&): " << allocated << " allocations in " << T << " rounds" << std::endl;
+    if (allocated!=0) {
+        std::cerr << "FAILED: LPSolver::update(Matrix&) allocates in steady state" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
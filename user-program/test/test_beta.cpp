@@ -0,0 +1,110 @@
+// sampleBeta draws from Beta(a, b) on both of its paths, the order
+// statistic of the small integer parameters and the Marsaglia-Tsang gamma
+// lanes of the others, shapes below 1 included: over 10^5 draws the mean
+// and the variance are within 5 standard errors of the closed form, and
+// where the CDF has a closed form the Kolmogorov-Smirnov distance is
+// below its 0.1% critical value.
+//
+//     olms-test-beta [draws]
+
+#include <cmath>
+
+#include "bandit/distributions.hpp"
+
+using namespace bandit;
+
+typedef double (*CDF)(double x);
+
+// Beta(2, 3)
+double cdfBeta23(double x)
+{
+    return x*x*(6-8*x+3*x*x);
+}
+
+// Beta(0.5, 0.5), the arcsine distribution
+double cdfArcsine(double x)
+{
+    return 2/M_PI*std::asin(std::sqrt(x));
+}
+
+// the samples of Beta(a, b) from every lane of batches of K
+bool checkBeta(double a, double b, uint draws, CDF cdf)
+{
+    const uint K = 16;
+    std::vector<double> as(K, a), bs(K, b), out;
+    std::vector<double> samples;
+    BetaScratch scratch;
+
+    seedRun(1, 0);
+    for (uint t = 0; samples.size()<draws; ++t) {
+        randomEngine.setStream(t, 0, RNG_STREAM_SELECT);
+        sampleBeta(as, bs, out, randomEngine, scratch);
+        samples.insert(samples.end(), out.begin(), out.end());
+    }
+
+    const double n = samples.size();
+    const double mean = a/(a+b);
+    const double var = a*b/((a+b)*(a+b)*(a+b+1));
+    // the variance of the sample variance, from the fourth central moment
+    const double m4 = 3*a*b*(a*b*(a+b-6)+2*(a+b)*(a+b))/((a+b)*(a+b)*(a+b)*(a+b)*(a+b+1)*(a+b+2)*(a+b+3));
+    double sum = 0, sumSq = 0;
+    for (const auto x : samples) {
+        if (!(x>=0 && x<=1)) {
+            std::cerr << "Beta(" << a << ", " << b << "): sample " << x << " out of [0, 1]" << std::endl;
+            return false;
+        }
+        sum += x;
+    }
+    const double sampleMean = sum/n;
+    for (const auto x : samples) {
+        sumSq += (x-sampleMean)*(x-sampleMean);
+    }
+    const double sampleVar = sumSq/(n-1);
+    const double meanErr = std::abs(sampleMean-mean)/std::sqrt(var/n);
+    const double varErr = std::abs(sampleVar-var)/std::sqrt((m4-var*var)/n);
+
+    double ks = 0;
+    if (cdf!=NULL) {
+        std::sort(samples.begin(), samples.end());
+        for (size_t i = 0; i<samples.size(); ++i) {
+            const double f = cdf(samples[i]);
+            ks = std::max(ks, std::max(std::abs(f-i/n), std::abs((i+1)/n-f)));
+        }
+    }
+    const double ksMax = 1.95/std::sqrt(n);
+
+    std::cout << "Beta(" << a << ", " << b << ")" << (isSmallIntegerBeta(a, b) ? ", order statistic" : ", gamma")
+              << ": mean " << sampleMean << " (" << meanErr << " se), variance " << sampleVar << " (" << varErr
+              << " se)";
+    if (cdf!=NULL) {
+        std::cout << ", KS " << ks << " (max " << ksMax << ")";
+    }
+    std::cout << std::endl;
+    return meanErr<5 && varErr<5 && ks<ksMax;
+}
+
+int main(int argc, char** argv)
+{
+    const uint draws = argc>1 ? (uint) std::strtoul(argv[1], NULL, 10) : 100000;
+    bool ok = true;
+
+    // the order statistic
+    ok = checkBeta(1, 1, draws, NULL) && ok;
+    ok = checkBeta(2, 3, draws, cdfBeta23) && ok;
+    ok = checkBeta(1, 8, draws, NULL) && ok;
+    ok = checkBeta(5, 4, draws, NULL) && ok;
+    // the gamma lanes, with shapes below 1, non-integer and large
+    ok = checkBeta(0.5, 0.5, draws, cdfArcsine) && ok;
+    ok = checkBeta(0.3, 0.7, draws, NULL) && ok;
+    ok = checkBeta(0.5, 4, draws, NULL) && ok;
+    ok = checkBeta(3.5, 2.2, draws, NULL) && ok;
+    ok = checkBeta(2, 8, draws, NULL) && ok;
+    ok = checkBeta(40, 60, draws, NULL) && ok;
+    ok = checkBeta(700, 300, draws, NULL) && ok;
+
+    if (!ok) {
+        std::cerr << "FAILED: a sample does not follow its Beta distribution" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+// The event loop of the kernel paths against a stand-in for the module: an
+// eventfd signals the publications of a page in memory, and a publisher
+// thread publishes the next sample once the controller decided on the last
+// one. Every publication must get exactly one decision, without waiting
+// for the timeout, and the empty publication of a connection that ended
+// must read as such.
+//
+//     olms-test-event-loop [publications]
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "bandit/init_util.hpp"
+
+using namespace bandit;
+
+const uint K = 4, M = 2;
+// the longest wait for a publication (us), never reached
+const uint DELTA_T = 5000000;
+
+static struct olms_shm_page page;
+static int efd;
+
+// the generation of the page at every decision
+static std::vector<uint32_t> decisions;
+static std::mutex decisionLock;
+static std::condition_variable decided;
+
+// the first n paths established, at the path indices of kernelMask()
+static void publish(uint n, uint round)
+{
+    uint32_t num_subflows = 0;
+    olms_shm_write_begin(&page);
+    for (uint i = 0; i<n; ++i) {
+        const uint pi = (K+1)*i+1;
+        olms_shm_set_subflow(&page, pi, 1000*(i+1)+round%7, 1000000*(i+1), round, 10*(round+1));
+        num_subflows = pi;
+    }
+    olms_shm_write_end(&page, num_subflows, n);
+
+    const uint64_t one = 1;
+    if (write(efd, &one, sizeof(one))!=sizeof(one)) {
+        std::cerr << "Failed to signal the publication" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// as OLMS_IOC_EXCHANGE, which returns the generation the preference applies from
+static int exchange(struct olms_exchange& args)
+{
+    std::lock_guard<std::mutex> lock(decisionLock);
+    if (args.count!=1 || __builtin_popcountll(args.prefer_bits[0])!=M) {
+        std::cerr << "FAILED: exchange of " << args.count << " sets, " << __builtin_popcountll(args.prefer_bits[0])
+                  << " paths preferred" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    args.generation = OLMS_READ_ONCE(page.generation);
+    decisions.push_back(args.generation);
+    decided.notify_one();
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    const uint T = argc>1 ? (uint) std::strtoul(argv[1], NULL, 10) : 1000;
+
+    olms_shm_init(&page);
+    efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (efd==-1) {
+        std::cerr << "Failed to create the eventfd" << std::endl;
+        return EXIT_FAILURE;
+    }
+    kolms.attach(efd, &page, exchange);
+    kolms.set_num_paths(K);
+    kolms.set_max_rtt(10000);
+    kolms.set_max_btlbw(10000000);
+
+    // the connection is up before the run, as after initKernelPaths()
+    publish(K, 0);
+    kolms.waitForPaths(K);
+
+    std::vector<PathPtr> paths;
+    for (uint i = 0; i<K; ++i) {
+        paths.push_back(PathPtr(new KernelPath({0, 1, 0}, i)));
+    }
+    std::vector<PolicyPtr> policies;
+    initPolicies(policies, K, "mpts", PolicyDefaults());
+    RoundwiseFullLog log(policies.size(), T, K, false);
+    Simulator<Policy, Path, RoundwiseFullLog> simulator(paths, policies, M, 0.4, DELTA_T);
+    log.addSimulation();
+    seedRun(1, 0);
+
+    // the publication of round t follows the decision of round t
+    std::thread publisher([T] {
+        for (uint t = 0; t<T; ++t) {
+            std::unique_lock<std::mutex> lock(decisionLock);
+            decided.wait(lock, [t] { return decisions.size()>t; });
+            lock.unlock();
+            publish(K, t+1);
+        }
+    });
+
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+    for (uint t = 0; t<T; ++t) {
+        simulator.execSingleRound(log, 0, t);
+    }
+    const double elapsedUs = std::chrono::duration<double, std::micro>(Clock::now()-start).count();
+    publisher.join();
+
+    std::cout << T << " publications, " << decisions.size() << " decisions in " << elapsedUs/1000 << " ms"
+              << std::endl;
+    if (decisions.size()!=T) {
+        std::cerr << "FAILED: " << decisions.size() << " decisions for " << T << " publications" << std::endl;
+        return EXIT_FAILURE;
+    }
+    for (uint t = 0; t<T; ++t) {
+        if (decisions[t]!=t+1) {
+            std::cerr << "FAILED: decision " << t << " at generation " << decisions[t] << ", expected " << t+1
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (kolms.lastGeneration!=T+1) {
+        std::cerr << "FAILED: the last round read generation " << kolms.lastGeneration << ", expected " << T+1
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (elapsedUs>=DELTA_T) {
+        std::cerr << "FAILED: a round waited for the timeout, a publication was missed" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // the kernel publishes no established subflow when the connection ends
+    publish(0, T+1);
+    if (!kolms.waitForSample(DELTA_T) || kolms.fetchMeasurements()!=-2) {
+        std::cerr << "FAILED: the end of the connection was not read" << std::endl;
+        return EXIT_FAILURE;
+    }
+    close(efd);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,168 @@
+// Exp3MPolicy keeps its weights in the log domain:
+//  - it selects as the linear weights of Exp3.M, with a sort per round,
+//    for as long as those do not overflow;
+//  - a path that fell far below the others, further than a double can
+//    hold, comes back once it becomes the best one.
+//
+//     olms-test-exp3m [rounds]
+
+#include "bandit/init_util.hpp"
+
+using namespace bandit;
+
+const double GAMMA = 0.1;
+
+// Exp3.M with linear weights, sorted in every round
+struct LinearExp3M {
+    const uint K;
+    double alpha_t;
+    std::vector<double> wi;
+    std::vector<double> pi;
+    std::vector<double> sorted;
+    std::vector<double> wsd;
+    RoundingScratch rounding;
+
+    explicit LinearExp3M(uint K)
+            :K(K), alpha_t(-1.0), wi(K, 1.0), pi(K, 1.0)
+    {
+    }
+
+    void selectNextPaths(uint l, std::vector<uint>& paths)
+    {
+        sorted = wi;
+        std::sort(sorted.begin(), sorted.end(), std::greater<double>());
+        const double rhs = (1.0/l-GAMMA/K)/(1-GAMMA);
+        const double s = vectorSum(sorted);
+        wsd = wi;
+        alpha_t = -1.0;
+        if (sorted[0]>=rhs*s) {
+            double rest = s;
+            for (uint k = 0; k<K; ++k) {
+                const double alpha = (rhs*rest)/(1-k*rhs);
+                if (alpha>sorted[k]) {
+                    alpha_t = alpha;
+                    break;
+                }
+                rest -= sorted[k];
+            }
+            for (uint i = 0; i<K; ++i) {
+                wsd[i] = std::min(alpha_t, wi[i]);
+            }
+        }
+        const double wsdsum = vectorSum(wsd);
+        for (uint i = 0; i<K; ++i) {
+            pi[i] = l*((1-GAMMA)*wsd[i]/wsdsum+GAMMA/K);
+        }
+        dependentRounding(l, pi, rounding, paths);
+    }
+
+    void updateState(const std::vector<uint>& is, const MetricBlock<>& rs)
+    {
+        for (const auto k : is) {
+            if (alpha_t<0 || wi[k]<alpha_t) {
+                wi[k] *= exp(is.size()*GAMMA*(rs[k].b/pi[k])/K);
+            }
+        }
+    }
+};
+
+// the bandwidth of path i in round t
+typedef double (*Bandwidth)(uint i, uint t);
+
+double stationary(uint i, uint)
+{
+    return 0.1+0.8*i/MAX_NUM_PATHS;
+}
+
+// path 0 is the only good one until SWITCH_ROUND, path 1 after; by then
+// the weight of path 1 is about 2000 nats below that of path 0, further
+// than the range of a double
+const uint SWITCH_ROUND = 80000;
+
+double switching(uint i, uint t)
+{
+    return i==(t<SWITCH_ROUND ? 0u : 1u) ? 1.0 : 0.0;
+}
+
+void measure(Bandwidth bandwidth, const std::vector<uint>& is, uint t, PathSet<>& selected, MetricBlock<>& rs)
+{
+    selected = PathSet<>(is);
+    for (const auto i : is) {
+        rs[i] = Metric(0, bandwidth(i, t), 0);
+    }
+}
+
+// the rounds until the linear weights overflow, -1 if the selections differ
+int compareLinear(uint K, uint M, uint T)
+{
+    Exp3MPolicy policy(K, GAMMA);
+    LinearExp3M linear(K);
+    std::vector<uint> is, js;
+    PathSet<> selected;
+    MetricBlock<> rs;
+
+    seedRun(1, 0);
+    for (uint t = 0; t<T; ++t) {
+        if (*std::max_element(linear.wi.begin(), linear.wi.end())>1e300) {
+            return t;
+        }
+        randomEngine.setStream(t, 0, RNG_STREAM_SELECT);
+        policy.selectNextPaths(M, is);
+        randomEngine.setStream(t, 0, RNG_STREAM_SELECT);
+        linear.selectNextPaths(M, js);
+        if (is!=js) {
+            std::cerr << "K=" << K << ": the selections differ in round " << t << std::endl;
+            return -1;
+        }
+        measure(stationary, is, t, selected, rs);
+        policy.updateState(selected, rs);
+        linear.updateState(js, rs);
+    }
+    return T;
+}
+
+// the fraction of the last 1000 of T rounds that select the path best after the switch
+double recovery(uint K, uint M, uint T)
+{
+    Exp3MPolicy policy(K, GAMMA);
+    std::vector<uint> is;
+    PathSet<> selected;
+    MetricBlock<> rs;
+    uint best = 0;
+
+    seedRun(1, 0);
+    for (uint t = 0; t<T; ++t) {
+        randomEngine.setStream(t, 0, RNG_STREAM_SELECT);
+        policy.selectNextPaths(M, is);
+        measure(switching, is, t, selected, rs);
+        policy.updateState(selected, rs);
+        if (t+1000>=T) {
+            for (const auto i : is) {
+                best += i==1;
+            }
+        }
+    }
+    return best/(1000.0*M);
+}
+
+int main(int argc, char** argv)
+{
+    const uint T = argc>1 ? (uint) std::strtoul(argv[1], NULL, 10) : 200000;
+    const uint Ks[] = {4, 8, 16, 64};
+    bool ok = true;
+
+    for (const auto K : Ks) {
+        const int rounds = compareLinear(K, 2, T);
+        std::cout << "K=" << K << ": the same selections as the linear weights over " << rounds << " rounds"
+                  << std::endl;
+        ok = ok && rounds>0;
+    }
+
+    const double share = recovery(4, 1, SWITCH_ROUND*3);
+    std::cout << "after the switch: " << share << " of the selections on the best path" << std::endl;
+    if (share<0.8) {
+        std::cerr << "FAILED: the path below the others does not come back" << std::endl;
+        ok = false;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
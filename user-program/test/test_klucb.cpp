@@ -0,0 +1,200 @@
+// KLUCBPolicy with a log(n) tolerance of 0 solves every index in every
+// round, and selects as the policy before the cache, which solved them
+// one by one with getKLUCBUpper: the same paths in every round, for the
+// basic and the mean-first selection. With the default tolerance the
+// regret stays close.
+//
+//     olms-test-klucb [rounds]
+
+#include "bandit/init_util.hpp"
+
+using namespace bandit;
+
+// KL-UCB as before the cache of the indices
+struct SolvedKLUCB {
+    const uint K;
+    const bool basic;
+    std::vector<int> Ni;
+    std::vector<double> Gi;
+    std::vector<double> indices, means;
+    std::vector<std::pair<double, uint>> ranked;
+    std::vector<uint> meanIndices, ucbPaths;
+    const double DELTA = 1e-8;
+    const double EPS = 1e-12;
+
+    SolvedKLUCB(uint K, bool basic)
+            :K(K), basic(basic), Ni(K, 0), Gi(K, 0.0)
+    {
+    }
+
+    double kl(double p, double q)
+    {
+        return p*log(p/q)+(1-p)*log((1-p)/(1-q));
+    }
+
+    double dkl(double p, double q)
+    {
+        return (q-p)/(q*(1.0-q));
+    }
+
+    double getKLUCBUpper(int k, int n)
+    {
+        const double logndn = log(n)/(double) Ni[k];
+        const double p = std::max(Gi[k]/(double) Ni[k], DELTA);
+        if (p>=1) return 1;
+        double q = p+DELTA;
+        for (int t = 0; t<20; ++t) {
+            const double f = logndn-kl(p, q);
+            const double df = -dkl(p, q);
+            if (f*f<EPS) {
+                break;
+            }
+            q = std::min(1-DELTA, std::max(q-f/df, p+DELTA));
+        }
+        return q;
+    }
+
+    // the l first of all (key, index) pairs, sorted
+    void maxIndices(const std::vector<double>& elems, uint l, std::vector<uint>& is)
+    {
+        ranked.clear();
+        for (uint i = 0; i<elems.size(); ++i) {
+            ranked.push_back(std::make_pair(-elems[i], i));
+        }
+        std::sort(ranked.begin(), ranked.end());
+        is.clear();
+        for (uint i = 0; i<ranked.size() && i<l; ++i) {
+            is.push_back(ranked[i].second);
+        }
+    }
+
+    void selectNextPaths(uint l, std::vector<uint>& paths)
+    {
+        const double n = vectorSum(Ni);
+        indices.resize(K);
+        for (uint k = 0; k<K; ++k) {
+            indices[k] = Ni[k]==0 ? 100000000 : getKLUCBUpper(k, n);
+        }
+        if (basic) {
+            maxIndices(indices, l, paths);
+            return;
+        }
+        means.resize(K);
+        for (uint i = 0; i<K; ++i) {
+            means[i] = (Gi[i]+1)/(Ni[i]+1);
+        }
+        maxIndices(means, l, paths);
+        std::vector<bool> isMeanIndex(K, false);
+        for (uint i = 0; i<l-1; ++i) {
+            isMeanIndex[paths[i]] = true;
+        }
+        maxIndices(indices, l, ucbPaths);
+        for (uint i = 0; i<l; ++i) {
+            if (!isMeanIndex[ucbPaths[i]]) {
+                paths[l-1] = ucbPaths[i];
+                break;
+            }
+        }
+    }
+
+    void updateState(const std::vector<uint>& is, const MetricBlock<>& rs)
+    {
+        for (const auto k : is) {
+            Ni[k] += 1;
+            Gi[k] += rs[k].b;
+        }
+    }
+};
+
+// the mean bandwidth of path i of K
+double meanBandwidth(uint i, uint K)
+{
+    return 0.1+0.8*i/K;
+}
+
+// Bernoulli bandwidths of the paths in is, drawn in round t
+void measure(const std::vector<uint>& is, uint K, uint t, PathSet<>& selected, MetricBlock<>& rs)
+{
+    randomEngine.setStream(t, 0, RNG_STREAM_UPDATE);
+    std::uniform_real_distribution<double> unif(0, 1);
+    selected = PathSet<>(is);
+    for (const auto i : is) {
+        rs[i] = Metric(0, unif(randomEngine)<meanBandwidth(i, K) ? 1.0 : 0.0, 0);
+    }
+}
+
+// the first round in which the cached policy selects otherwise, T if none
+uint compareSolved(uint K, uint M, bool basic, uint T)
+{
+    KLUCBPolicy policy(K, basic, 0);
+    SolvedKLUCB solved(K, basic);
+    std::vector<uint> is, js;
+    PathSet<> selected;
+    MetricBlock<> rs;
+
+    seedRun(1, 0);
+    for (uint t = 0; t<T; ++t) {
+        policy.selectNextPaths(M, is);
+        solved.selectNextPaths(M, js);
+        if (is!=js) {
+            return t;
+        }
+        measure(is, K, t, selected, rs);
+        policy.updateState(selected, rs);
+        solved.updateState(js, rs);
+    }
+    return T;
+}
+
+// the expected bandwidth lost to the M best paths over T rounds
+double regret(uint K, uint M, double tolerance, uint T)
+{
+    KLUCBPolicy policy(K, true, tolerance);
+    std::vector<uint> is;
+    PathSet<> selected;
+    MetricBlock<> rs;
+    double best = 0, got = 0;
+
+    for (uint i = 0; i<M; ++i) {
+        best += meanBandwidth(K-1-i, K);
+    }
+    seedRun(1, 0);
+    for (uint t = 0; t<T; ++t) {
+        policy.selectNextPaths(M, is);
+        for (const auto i : is) {
+            got += meanBandwidth(i, K);
+        }
+        measure(is, K, t, selected, rs);
+        policy.updateState(selected, rs);
+    }
+    return best*T-got;
+}
+
+int main(int argc, char** argv)
+{
+    const uint T = argc>1 ? (uint) std::strtoul(argv[1], NULL, 10) : 20000;
+    const uint M = 2;
+    bool ok = true;
+
+    for (uint K : {4u, 16u, 64u}) {
+        for (bool basic : {true, false}) {
+            const uint rounds = compareSolved(K, M, basic, T);
+            std::cout << "K=" << K << (basic ? ", basic" : ", mean first") << ": the same selections over "
+                      << rounds << " of " << T << " rounds" << std::endl;
+            if (rounds!=T) {
+                std::cerr << "FAILED: tolerance 0 selects otherwise than the solved indices in round " << rounds
+                          << std::endl;
+                ok = false;
+            }
+        }
+        const double exact = regret(K, M, 0, T);
+        const double cached = regret(K, M, KLUCB_LOGN_TOLERANCE, T);
+        std::cout << "K=" << K << ": regret " << exact << " with tolerance 0, " << cached << " with "
+                  << KLUCB_LOGN_TOLERANCE << std::endl;
+        if (cached>1.1*exact+10) {
+            std::cerr << "FAILED: the cached indices lose more than 10% of regret" << std::endl;
+            ok = false;
+        }
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,57 @@
+// dependentRounding keeps the marginals: over 10^6 draws every path is
+// selected with frequency ps[i], within 5 standard errors, a path of
+// probability 0 or 1 never or always, and every draw selects exactly l
+// distinct paths.
+//
+//     olms-test-rounding [draws]
+
+#include "bandit/bandit_util.hpp"
+
+using namespace bandit;
+
+bool checkMarginals(uint l, const std::vector<double>& ps, uint draws)
+{
+    const uint K = (uint) ps.size();
+    RoundingScratch scratch;
+    std::vector<uint> selected;
+    std::vector<uint64_t> counts(K, 0);
+    std::vector<bool> seen(K);
+    bool ok = true;
+
+    seedRun(1, 0);
+    for (uint t = 0; t<draws; ++t) {
+        randomEngine.setStream(t, 0, RNG_STREAM_SELECT);
+        dependentRounding(l, ps, scratch, selected);
+        if (selected.size()!=l) {
+            std::cerr << "draw " << t << ": " << selected.size() << " paths selected, expected " << l << std::endl;
+            return false;
+        }
+        std::fill(seen.begin(), seen.end(), false);
+        for (const auto i : selected) {
+            if (i>=K || seen[i]) {
+                std::cerr << "draw " << t << ": path " << i << " out of range or selected twice" << std::endl;
+                return false;
+            }
+            seen[i] = true;
+            ++counts[i];
+        }
+    }
+
+    for (uint i = 0; i<K; ++i) {
+        const double freq = double(counts[i])/draws;
+        const double tolerance = 5*std::sqrt(ps[i]*(1-ps[i])/draws);
+        const bool pass = (ps[i]==0 || ps[i]==1) ? freq==ps[i] : std::abs(freq-ps[i])<=tolerance;
+        std::cout << "p " << ps[i] << "\tfrequency " << freq << (pass ? "" : "\tFAILED") << std::endl;
+        ok = ok && pass;
+    }
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    const uint draws = argc>1 ? (uint) std::strtoul(argv[1], NULL, 10) : 1000000;
+    bool ok = checkMarginals(4, {0.0, 1.0, 0.3, 0.7, 0.25, 0.75, 0.5, 0.5}, draws);
+    ok = checkMarginals(5, {0.05, 0.15, 0.35, 0.45, 0.6, 0.9, 0.5, 0.0, 1.0, 0.4, 0.3, 0.3}, draws) && ok;
+    ok = checkMarginals(1, {0.2, 0.2, 0.2, 0.2, 0.2}, draws) && ok;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
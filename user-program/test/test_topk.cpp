@@ -0,0 +1,84 @@
+// vectorMaxIndices and vectorMinIndices select as the sort of all
+// (key, index) pairs they replace, ties to the lower index and in key
+// order, for every l up to K+1: l<=TOP_INSERTION_MAX takes the insertion
+// array, a larger l the stable sort of all indices. The keys are drawn from
+// a few values, so that most of them tie, and from many.
+//
+//     olms-test-topk [rounds]
+
+#include "bandit/bandit_util.hpp"
+
+using namespace bandit;
+
+// the helper before topIndices: the l first of all pairs, sorted
+template<bool largest, class T>
+std::vector<uint> sortedIndices(const std::vector<T>& elems, uint l)
+{
+    std::vector<std::pair<T, uint>> elemPairs;
+    for (uint i = 0; i<elems.size(); ++i) {
+        elemPairs.push_back(std::make_pair(largest ? -elems[i] : elems[i], i));
+    }
+    std::sort(elemPairs.begin(), elemPairs.end());
+    std::vector<uint> is;
+    for (uint i = 0; i<elemPairs.size() && i<l; ++i) {
+        is.push_back(elemPairs[i].second);
+    }
+    return is;
+}
+
+// K keys out of values distinct ones
+template<class T>
+void fill(uint K, uint values, std::vector<T>& elems)
+{
+    std::uniform_int_distribution<int> value(0, values-1);
+    elems.resize(K);
+    for (auto& e : elems) {
+        e = (T) value(randomEngine);
+    }
+}
+
+template<class T>
+bool compare(const char* type, uint K, uint values, uint rounds)
+{
+    std::vector<T> elems;
+    std::vector<uint> order, is;
+
+    for (uint t = 0; t<rounds; ++t) {
+        randomEngine.setStream(t, K, RNG_STREAM_SELECT);
+        fill(K, values, elems);
+        for (uint l = 0; l<=K+1; ++l) {
+            vectorMaxIndices(elems, l, order, is);
+            const bool maxOk = is==sortedIndices<true>(elems, l);
+            vectorMinIndices(elems, l, order, is);
+            const bool minOk = is==sortedIndices<false>(elems, l);
+            if (!maxOk || !minOk) {
+                std::cerr << type << " K=" << K << " l=" << l << ", " << values << " values: "
+                          << (maxOk ? "vectorMinIndices" : "vectorMaxIndices") << " differs in round " << t
+                          << std::endl;
+                return false;
+            }
+        }
+    }
+    std::cout << type << " K=" << K << ", " << values << " values: the same indices over " << rounds << " rounds"
+              << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const uint T = argc>1 ? (uint) std::strtoul(argv[1], NULL, 10) : 200;
+    bool ok = true;
+
+    seedRun(1, 0);
+    for (uint K : {1u, 2u, 4u, 8u, 9u, 16u, 33u, 64u}) {
+        for (uint values : {2u, 5u, 1000000u}) {
+            ok = compare<double>("double", K, values, T) && ok;
+            ok = compare<int>("int", K, values, T) && ok;
+        }
+    }
+    if (!ok) {
+        std::cerr << "FAILED: topIndices does not select as the sort of all pairs" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}